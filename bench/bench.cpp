@@ -0,0 +1,755 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+#include <chrono>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <functional>
+#include <map>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "../src/event_splitter.h"
+#include "../src/scan_kernels.h"
+#include "../src/sysmon_scanner.h"
+#include "../src/event_plans.h"
+#include "../src/field_translation.h"
+#include "../src/ilf_view.h"
+#include "../lib/libilf/ILF/ILF.h"
+#include "../lib/libilf/ILF/ILF_binary.h"
+#include "../lib/libilf/ILF/ILF_parser.h"
+#include "../lib/libilf/ILF/ILF_ring.h"
+#ifdef GENERATED_TRANSLATORS
+#include "../src/generated_translators.h"
+#endif
+#include "../lib/json/single_include/nlohmann/json.hpp"
+
+using namespace std;
+using json = nlohmann::json;
+
+/*
+    Usage:
+        ./bench [-b <benchmark>] [-c <corpus.xml>] [-n <corpus_size_in_MB>] [-f <allowed_fields.json>]
+                [-m <field_mappings.json>] [-e <event_names.json>]
+
+        -b  runs a single group of benchmarks (default: all)
+                scan    byte-scanning kernels for event boundaries
+                fields  field lookup by event type: map of every Data element vs. perfect-hash slots
+                translate  translation by event type: plans compiled from the configuration files vs.
+                        generated translators (built with make GENERATED=1)
+                ilf     rendering translated events as ILF text, parsing the text back, and encoding and
+                        decoding them in binary
+                ring    passing translated events to another thread through the shared memory ring:
+                        throughput, and latency with a reader that sleeps and one that spins
+        -c  XML file whose events are repeated to build the corpus (default: ../test/input-logs/five_events.xml)
+        -n  size of the corpus in MB (default: 256)
+        -f  allowed fields configuration used by the fields, translate, ilf and ring benchmarks
+            (default: ../lib/sysmon_configurations/allowed-field-configs/allowed_fields.json)
+        -m  field mappings configuration used by the translate, ilf and ring benchmarks
+            (default: ../lib/sysmon_configurations/field-mappings-configs/field_mappings.json)
+        -e  event names configuration used by the translate, ilf and ring benchmarks
+            (default: ../lib/sysmon_configurations/name-mappings-configs/event_names.json)
+
+    Notes:
+        - Each benchmark is run a few times and the best time is reported.
+        - Throughput is reported over the size of the corpus, so numbers are comparable between benchmarks,
+          except for ilf and ring, which report it over the size of the rendered text.
+*/
+
+#define BENCH_REPEATS 3
+
+// events of each type kept by the translate benchmark, and passes made over them per run
+#define BENCH_TRANSLATE_SAMPLES 10000
+#define BENCH_TRANSLATE_PASSES 10
+
+// translated events rendered by the ilf benchmark, and passes made over them per run
+#define BENCH_ILF_EVENTS 50000
+#define BENCH_ILF_PASSES 10
+
+// size of the ring, events passed through it per run, and events timed one at a time, with a pause
+// between them long enough for a reader that doesn't spin to fall asleep
+#define BENCH_RING_BYTES (4 << 20)
+#define BENCH_RING_PASSES 10
+#define BENCH_RING_LATENCY_SAMPLES 20000
+#define BENCH_RING_LATENCY_GAP_US 50
+
+string corpus_path = "../test/input-logs/five_events.xml";
+size_t corpus_size = 256 << 20;
+string allowed_fields_path = "../lib/sysmon_configurations/allowed-field-configs/allowed_fields.json";
+string field_mappings_path = "../lib/sysmon_configurations/field-mappings-configs/field_mappings.json";
+string event_names_path = "../lib/sysmon_configurations/name-mappings-configs/event_names.json";
+
+// Reads a string in place, so that stream benchmarks don't time copying the corpus into a stream
+struct memory_streambuf : streambuf {
+    memory_streambuf(const string &s)
+    {
+        char *p = const_cast<char *>(s.data());
+        setg(p, p, p + s.size());
+    }
+};
+
+string build_corpus(string path, size_t size);
+double time_best(function<void()> f);
+void report(string name, size_t bytes, double seconds, string extra = "");
+void bench_scan(const string &corpus);
+void bench_fields(const string &corpus);
+void bench_translate(const string &corpus);
+void bench_ilf(const string &corpus);
+void bench_ring(const string &corpus);
+size_t translate_corpus(string &events, const EVENT_PLANS &plans, vector<ILF_VIEW> &views, size_t max_events);
+bool read_configs(json &allowed_fields, json &field_mappings, json &event_names);
+
+int main (int argc, char *argv[])
+{
+    map<string, string> args;
+    for (int i = 1; i + 1 < argc; i += 2)
+        args[argv[i]] = argv[i + 1];
+
+    string group = args.count("-b") ? args["-b"] : "all";
+    corpus_path  = args.count("-c") ? args["-c"] : corpus_path;
+    corpus_size  = args.count("-n") ? stoul(args["-n"]) << 20 : corpus_size;
+    allowed_fields_path = args.count("-f") ? args["-f"] : allowed_fields_path;
+    field_mappings_path = args.count("-m") ? args["-m"] : field_mappings_path;
+    event_names_path = args.count("-e") ? args["-e"] : event_names_path;
+
+    string corpus = build_corpus(corpus_path, corpus_size);
+    cout << "Corpus: " << corpus.size() / (1 << 20) << " MB built from " << corpus_path << endl << endl;
+
+    if (group == "all" || group == "scan")
+        bench_scan(corpus);
+    if (group == "all" || group == "fields")
+        bench_fields(corpus);
+    if (group == "all" || group == "translate")
+        bench_translate(corpus);
+    if (group == "all" || group == "ilf")
+        bench_ilf(corpus);
+    if (group == "all" || group == "ring")
+        bench_ring(corpus);
+
+    return 0;
+}
+
+// Repeats the events of the given file, one per line, until the corpus reaches the given size.
+string build_corpus(string path, size_t size)
+{
+    ifstream input(path, ios::binary);
+    string contents((istreambuf_iterator<char>(input)), istreambuf_iterator<char>());
+
+    vector<string> events;
+    const char *p = contents.data(), *end = p + contents.size();
+    while (true) {
+        const char *open = find_event_open(p, end);
+        if (open == end)
+            break;
+        p = find_event_close(open, end);
+        if (p == end)
+            break;
+        p += EVENT_CLOSE_TAG_LEN;
+        events.push_back(string(open, p));
+    }
+    if (events.empty()) {
+        cerr << "No events found in " << path << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    string corpus = "<Events>\n";
+    corpus.reserve(size + (1 << 20));
+    while (corpus.size() < size) {
+        for (string &event : events)
+            corpus += event + "\n";
+    }
+    return corpus + "</Events>\n";
+}
+
+// runs f BENCH_REPEATS times and returns the best wall time in seconds
+double time_best(function<void()> f)
+{
+    double best = 1e30;
+    for (int i = 0; i < BENCH_REPEATS; i++) {
+        auto start = chrono::steady_clock::now();
+        f();
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        best = min(best, elapsed.count());
+    }
+    return best;
+}
+
+void report(string name, size_t bytes, double seconds, string extra /* = "" */)
+{
+    cout << "  " << left << setw(44) << name << right << fixed << setprecision(2)
+         << setw(8) << bytes / seconds / 1e9 << " GB/s" << (extra.empty() ? "" : "  " + extra) << endl;
+}
+
+// Event-boundary scanning: the line splitting the stdin path used to do, and the event splitter
+// over a stream and over a buffer (the mmap path), with each kernel.
+void bench_scan(const string &corpus)
+{
+    cout << "Byte scanning" << endl;
+    const char *begin = corpus.data(), *end = begin + corpus.size();
+    size_t count = 0;
+
+    double t = time_best([&]() {
+        memory_streambuf buffer(corpus);
+        istream stream(&buffer);
+        string line;
+        count = 0;
+        while (getline(stream, line))
+            count++;
+    });
+    report("getline (previous stdin path)", corpus.size(), t, to_string(count) + " lines");
+
+    for (scan_kernel kernel : { SCAN_SCALAR, SCAN_SSE2, SCAN_AVX2 }) {
+        if (!set_scan_kernel(kernel)) {
+            cout << "  " << get_scan_kernel_name(kernel) << " not supported on this CPU" << endl;
+            continue;
+        }
+        string name = get_scan_kernel_name(kernel);
+
+        t = time_best([&]() {
+            memory_streambuf buffer(corpus);
+            istream stream(&buffer);
+            EVENT_SPLITTER splitter(stream);
+            char *event;
+            size_t length;
+            count = 0;
+            while (splitter.next_event(event, length))
+                count++;
+        });
+        report("EVENT_SPLITTER over a stream [" + name + "]", corpus.size(), t, to_string(count) + " events");
+
+        t = time_best([&]() {
+            const char *p = begin;
+            count = 0;
+            while ((p = find_event_open(p, end)) != end) {
+                p = find_event_close(p, end) + EVENT_CLOSE_TAG_LEN;
+                count++;
+            }
+        });
+        report("event boundaries over a buffer [" + name + "]", corpus.size(), t, to_string(count) + " events");
+    }
+    cout << endl;
+}
+
+// Looking up the allowed fields of each event, by event type: the map the translator used to build
+// from every Data element and query with at(), against storing the values in perfect-hash slots.
+// Extraction itself is left out: both sides start from the scanned (name, value) pairs.
+void bench_fields(const string &corpus)
+{
+    cout << "Field lookup by event type" << endl;
+
+    struct sample {
+        size_t bytes;
+        vector<pair<string_view, string_view>> data;
+    };
+
+    // scanning decodes in place, so it runs on a copy that the samples point into
+    string events = corpus;
+    // by event ID, shortest first so numeric IDs are in order
+    auto id_order = [](const string &a, const string &b) { return a.size() != b.size() ? a.size() < b.size() : a < b; };
+    map<string, vector<sample>, decltype(id_order)> samples(id_order);
+    char *p = &events[0], *end = p + events.size();
+    sysmon_fields fields;
+    while ((p = (char *) find_event_open(p, end)) != end) {
+        char *close = (char *) find_event_close(p, end) + EVENT_CLOSE_TAG_LEN;
+        if (scan_sysmon_event(p, close - p, fields))
+            samples[string(fields.id)].push_back({ (size_t) (close - p), fields.data });
+        p = close;
+    }
+
+    json allowed_fields;
+    ifstream allowed_fields_file(allowed_fields_path);
+    if (allowed_fields_file)
+        allowed_fields_file >> allowed_fields;
+    else
+        cout << "  " << allowed_fields_path << " not found, every field is allowed" << endl;
+
+    EVENT_PLANS plans;
+    for (auto &type : samples) {
+        event_plan &plan = plans.add(type.first);
+        plan.disposition = EVENT_TRANSLATED;
+
+        vector<string> names;
+        if (allowed_fields.contains(type.first))
+            names = allowed_fields[type.first].get<vector<string>>();
+        else
+            for (auto &d : type.second[0].data)
+                names.push_back(string(d.first));
+
+        for (string &name : names)
+            plan.fields.push_back({ name, -1, SPLIT_NONE, QUOTE_UNLESS_NUMBER, "", {} });
+    }
+    plans.assign_slots();
+
+    volatile size_t sink = 0;
+    for (auto &type : samples) {
+        const vector<sample> &type_samples = type.second;
+        const event_plan &plan = plans.find(type.first);
+        size_t bytes = 0;
+        for (const sample &s : type_samples)
+            bytes += s.bytes;
+
+        double map_time = time_best([&]() {
+            for (const sample &s : type_samples) {
+                map<string, string> event_data;
+                for (auto &d : s.data)
+                    event_data.insert({ string(d.first), string(d.second) });
+                for (const field_plan &field : plan.fields) {
+                    auto it = event_data.find(field.source);
+                    if (it != event_data.end())
+                        sink += it->second.size();
+                }
+            }
+        });
+
+        double slot_time = time_best([&]() {
+            for (const sample &s : type_samples) {
+                fields.clear(plans.get_slot_count());
+                fields.projected = true;
+                for (auto &d : s.data) {
+                    string_view *value = fields.claim(plans.find_slot(plan, d.first));
+                    if (value != nullptr)
+                        *value = d.second;
+                }
+                for (const field_plan &field : plan.fields) {
+                    if (fields.has_value(field.slot))
+                        sink += fields.values[field.slot].size();
+                }
+            }
+        });
+
+        ostringstream per_event;
+        per_event << fixed << setprecision(0) << map_time / type_samples.size() * 1e9 << " ns/event";
+        report("EventID " + type.first + ": map", bytes, map_time, per_event.str());
+
+        per_event.str("");
+        per_event << fixed << setprecision(0) << slot_time / type_samples.size() * 1e9 << " ns/event, "
+                  << setprecision(1) << map_time / slot_time << "x";
+        report("EventID " + type.first + ": slots", bytes, slot_time, per_event.str());
+    }
+    cout << endl;
+}
+
+// Turning the extracted fields of each event type into ILF attributes: following the plans compiled
+// from the configuration files at run time, against the translators generated from them at build
+// time. Both sides start from the projected fields, so extraction is left out. The configuration
+// files have to be the ones the translators were generated from, which is checked on the output.
+void bench_translate(const string &corpus)
+{
+    cout << "Translation by event type" << endl;
+#ifndef GENERATED_TRANSLATORS
+    cout << "  built without generated translators, see make GENERATED=1" << endl << endl;
+#else
+    json allowed_fields, field_mappings, event_names;
+    if (!read_configs(allowed_fields, field_mappings, event_names))
+        return;
+
+    EVENT_PLANS plans, generated_plans;
+    plans.compile(event_names, allowed_fields, field_mappings, {});
+    if (!generated_plans.load_generated(generated_events, generated_event_count,
+                                        generated_slot_names, generated_slot_count)) {
+        cout << "  the generated translators don't match their plans" << endl << endl;
+        return;
+    }
+
+    struct sample {
+        size_t bytes;
+        sysmon_fields fields;           // projected onto the compiled plans
+        sysmon_fields generated_fields; // projected onto the generated plans
+    };
+
+    // scanning decodes in place, so each side scans its own copy, which its samples point into
+    string events = corpus, generated_events_copy = corpus;
+    auto id_order = [](const string &a, const string &b) { return a.size() != b.size() ? a.size() < b.size() : a < b; };
+    map<string, vector<sample>, decltype(id_order)> samples(id_order);
+    char *p = &events[0], *end = p + events.size();
+    char *q = &generated_events_copy[0];
+    sample s;
+    while ((p = (char *) find_event_open(p, end)) != end) {
+        char *close = (char *) find_event_close(p, end) + EVENT_CLOSE_TAG_LEN;
+        s.bytes = close - p;
+        bool scanned = scan_sysmon_event(p, s.bytes, s.fields, &plans) &&
+                       scan_sysmon_event(q + (p - &events[0]), s.bytes, s.generated_fields, &generated_plans);
+        vector<sample> &type_samples = samples[string(s.fields.id)];
+        if (scanned && plans.find(s.fields.id).disposition == EVENT_TRANSLATED && type_samples.size() < BENCH_TRANSLATE_SAMPLES)
+            type_samples.push_back(s);
+        p = close;
+    }
+
+    volatile size_t sink = 0;
+    vector<ilf_attribute> attributes, generated_attributes;
+    for (auto &type : samples) {
+        const vector<sample> &type_samples = type.second;
+        if (type_samples.empty())
+            continue;
+        const event_plan &plan = plans.find(type.first);
+
+        size_t bytes = 0, mismatches = 0;
+        for (const sample &s : type_samples) {
+            bytes += s.bytes * BENCH_TRANSLATE_PASSES;
+
+            attributes.clear();
+            generated_attributes.clear();
+            translate_fields(plan, s.fields, attributes);
+            translate_generated(s.generated_fields.id, s.generated_fields, generated_attributes);
+            bool same = attributes.size() == generated_attributes.size();
+            for (size_t i = 0; same && i < attributes.size(); i++)
+                same = attributes[i].key == generated_attributes[i].key && attributes[i].value == generated_attributes[i].value &&
+                       attributes[i].quoting == generated_attributes[i].quoting;
+            mismatches += !same;
+        }
+
+        double plan_time = time_best([&]() {
+            for (int pass = 0; pass < BENCH_TRANSLATE_PASSES; pass++) {
+                for (const sample &s : type_samples) {
+                    attributes.clear();
+                    translate_fields(plan, s.fields, attributes);
+                    sink += attributes.size();
+                }
+            }
+        });
+
+        double generated_time = time_best([&]() {
+            for (int pass = 0; pass < BENCH_TRANSLATE_PASSES; pass++) {
+                for (const sample &s : type_samples) {
+                    generated_attributes.clear();
+                    translate_generated(s.generated_fields.id, s.generated_fields, generated_attributes);
+                    sink += generated_attributes.size();
+                }
+            }
+        });
+
+        size_t translated = type_samples.size() * BENCH_TRANSLATE_PASSES;
+        ostringstream per_event;
+        per_event << fixed << setprecision(0) << plan_time / translated * 1e9 << " ns/event";
+        report("EventID " + type.first + ": plans", bytes, plan_time, per_event.str());
+
+        per_event.str("");
+        per_event << fixed << setprecision(0) << generated_time / translated * 1e9 << " ns/event, "
+                  << setprecision(2) << plan_time / generated_time << "x"
+                  << (mismatches ? ", " + to_string(mismatches) + " events translated differently" : "");
+        report("EventID " + type.first + ": generated", bytes, generated_time, per_event.str());
+    }
+    cout << endl;
+#endif
+}
+
+// Rendering translated events as ILF text, the way the translator writes each event to stdout and
+// Redis: a new string from to_string() for every event, appending to one buffer that is cleared
+// between events, and rendering the views the translator builds, which quote values as they go.
+void bench_ilf(const string &corpus)
+{
+    cout << "ILF rendering" << endl;
+
+    json allowed_fields, field_mappings, event_names;
+    if (!read_configs(allowed_fields, field_mappings, event_names))
+        return;
+    EVENT_PLANS plans;
+    plans.compile(event_names, allowed_fields, field_mappings, {});
+
+    string events = corpus;
+    vector<ILF_VIEW> views;
+    translate_corpus(events, plans, views, BENCH_ILF_EVENTS);
+    vector<ILF> ilfs;
+    size_t bytes = 0;
+    for (ILF_VIEW &view : views) {
+        ilfs.push_back(view.to_ilf());
+        bytes += ilfs.back().text_size() * BENCH_ILF_PASSES;
+    }
+    if (ilfs.empty()) {
+        cout << "  no translated events in the corpus" << endl << endl;
+        return;
+    }
+
+    volatile size_t sink = 0;
+    double to_string_time = time_best([&]() {
+        for (int pass = 0; pass < BENCH_ILF_PASSES; pass++) {
+            for (ILF &ilf : ilfs)
+                sink += ilf.to_string().size();
+        }
+    });
+
+    string text;
+    double append_time = time_best([&]() {
+        for (int pass = 0; pass < BENCH_ILF_PASSES; pass++) {
+            for (ILF &ilf : ilfs) {
+                text.clear();
+                ilf.append_to(text);
+                sink += text.size();
+            }
+        }
+    });
+
+    double view_time = time_best([&]() {
+        for (int pass = 0; pass < BENCH_ILF_PASSES; pass++) {
+            for (ILF_VIEW &view : views) {
+                text.clear();
+                view.append_to(text);
+                sink += text.size();
+            }
+        }
+    });
+
+    // each pass is a stream of its own, so the dictionary is sent in every pass, as a new
+    // subscriber would get it
+    string binary;
+    double encode_time = time_best([&]() {
+        for (int pass = 0; pass < BENCH_ILF_PASSES; pass++) {
+            ILF_ENCODER encoder;
+            binary.clear();
+            for (ILF &ilf : ilfs)
+                encoder.encode(ilf, binary);
+            sink += binary.size();
+        }
+    });
+
+    double view_encode_time = time_best([&]() {
+        for (int pass = 0; pass < BENCH_ILF_PASSES; pass++) {
+            ILF_ENCODER encoder;
+            binary.clear();
+            for (ILF_VIEW &view : views)
+                view.encode(encoder, binary);
+            sink += binary.size();
+        }
+    });
+
+    double decode_text_time = time_best([&]() {
+        for (int pass = 0; pass < BENCH_ILF_PASSES; pass++) {
+            ILF_DECODER decoder;
+            string_view in = binary;
+            text.clear();
+            while (decoder.next_text(in, text)) {
+                sink += text.size();
+                text.clear();
+            }
+        }
+    });
+
+    double decode_time = time_best([&]() {
+        for (int pass = 0; pass < BENCH_ILF_PASSES; pass++) {
+            ILF_DECODER decoder;
+            string_view in = binary;
+            ILF ilf;
+            while (decoder.next(in, ilf))
+                sink += ilf.get_pairs().size();
+        }
+    });
+
+    // parsing the text back, one event per line as the translator writes them, with each kernel
+    string lines;
+    for (ILF &ilf : ilfs) {
+        ilf.append_to(lines);
+        lines += '\n';
+    }
+    vector<pair<ilf_parse_kernel, double>> parse_times;
+    ilf_parse_kernel best = get_ilf_parse_kernel();
+    for (ilf_parse_kernel kernel : { ILF_PARSE_SCALAR, ILF_PARSE_SSE2, ILF_PARSE_AVX2 }) {
+        if (!set_ilf_parse_kernel(kernel))
+            continue;
+        ILF_PARSER parser;
+        parse_times.push_back({ kernel, time_best([&]() {
+            for (int pass = 0; pass < BENCH_ILF_PASSES; pass++) {
+                string_view in = lines;
+                while (parser.next(in))
+                    sink += parser.pairs.size();
+            }
+        }) });
+    }
+    set_ilf_parse_kernel(best);
+
+    size_t rendered = ilfs.size() * BENCH_ILF_PASSES;
+    ostringstream per_event;
+    per_event << fixed << setprecision(0) << to_string_time / rendered * 1e9 << " ns/event";
+    report("ILF::to_string", bytes, to_string_time, per_event.str());
+
+    per_event.str("");
+    per_event << fixed << setprecision(0) << append_time / rendered * 1e9 << " ns/event, "
+              << setprecision(2) << to_string_time / append_time << "x";
+    report("ILF::append_to into a reused buffer", bytes, append_time, per_event.str());
+
+    per_event.str("");
+    per_event << fixed << setprecision(0) << view_time / rendered * 1e9 << " ns/event, "
+              << setprecision(2) << to_string_time / view_time << "x";
+    report("ILF_VIEW::append_to into a reused buffer", bytes, view_time, per_event.str());
+
+    per_event.str("");
+    per_event << fixed << setprecision(0) << encode_time / rendered * 1e9 << " ns/event, "
+              << setprecision(2) << to_string_time / encode_time << "x, "
+              << setprecision(0) << 100.0 * binary.size() * BENCH_ILF_PASSES / bytes << "% of the text size";
+    report("ILF_ENCODER::encode", bytes, encode_time, per_event.str());
+
+    per_event.str("");
+    per_event << fixed << setprecision(0) << view_encode_time / rendered * 1e9 << " ns/event, "
+              << setprecision(2) << to_string_time / view_encode_time << "x";
+    report("ILF_VIEW::encode", bytes, view_encode_time, per_event.str());
+
+    per_event.str("");
+    per_event << fixed << setprecision(0) << decode_text_time / rendered * 1e9 << " ns/event";
+    report("ILF_DECODER::next_text", bytes, decode_text_time, per_event.str());
+
+    per_event.str("");
+    per_event << fixed << setprecision(0) << decode_time / rendered * 1e9 << " ns/event";
+    report("ILF_DECODER::next into an ILF", bytes, decode_time, per_event.str());
+
+    for (auto &parse_time : parse_times) {
+        per_event.str("");
+        per_event << fixed << setprecision(0) << parse_time.second / rendered * 1e9 << " ns/event, "
+                  << setprecision(2) << parse_times[0].second / parse_time.second << "x";
+        report(string("ILF_PARSER::next (") + get_ilf_parse_kernel_name(parse_time.first) + ")", bytes,
+               parse_time.second, per_event.str());
+    }
+    cout << endl;
+}
+
+// Translates the events of the corpus, up to max_events, with the translator's metadata so that
+// they render as they would in its output. The views point into events, which is scanned in place.
+size_t translate_corpus(string &events, const EVENT_PLANS &plans, vector<ILF_VIEW> &views, size_t max_events)
+{
+    char *p = &events[0], *end = p + events.size();
+    sysmon_fields fields;
+    while ((p = (char *) find_event_open(p, end)) != end && views.size() < max_events) {
+        char *close = (char *) find_event_close(p, end) + EVENT_CLOSE_TAG_LEN;
+        const event_plan &plan = plans.find(scan_sysmon_event(p, close - p, fields, &plans) ? fields.id : "");
+        p = close;
+        if (plan.disposition != EVENT_TRANSLATED)
+            continue;
+
+        ILF_VIEW view;
+        view.event_type = plan.event_name;
+        view.sender = fields.computer;
+        view.receiver = "*";
+        view.time = fields.time;
+        view.attributes.push_back({ "event__code", fields.id, QUOTE_NEVER });
+        translate_fields(plan, fields, view.attributes);
+        views.push_back(view);
+    }
+    return views.size();
+}
+
+// Percentiles of the latencies, in microseconds
+static string latency_summary(vector<double> &latencies)
+{
+    sort(latencies.begin(), latencies.end());
+    auto at = [&](double fraction) { return latencies[min(latencies.size() - 1, (size_t) (fraction * latencies.size()))]; };
+    ostringstream summary;
+    summary << fixed << setprecision(1) << "p50 " << at(0.5) << " us, p99 " << at(0.99) << " us, p99.9 "
+            << at(0.999) << " us, max " << latencies.back() << " us";
+    return summary.str();
+}
+
+// Translated events written to the ring and read back by another thread, as a detection engine on
+// the same host would: all of them as fast as possible, then one at a time, timed from before the
+// write to after the read
+void bench_ring(const string &corpus)
+{
+    cout << "Shared memory ring" << endl;
+
+    json allowed_fields, field_mappings, event_names;
+    if (!read_configs(allowed_fields, field_mappings, event_names))
+        return;
+    EVENT_PLANS plans;
+    plans.compile(event_names, allowed_fields, field_mappings, {});
+
+    string events = corpus;
+    vector<ILF_VIEW> views;
+    translate_corpus(events, plans, views, BENCH_ILF_EVENTS);
+    vector<string> texts;
+    size_t bytes = 0;
+    for (ILF_VIEW &view : views) {
+        texts.push_back("");
+        view.append_to(texts.back());
+        bytes += texts.back().size() * BENCH_RING_PASSES;
+    }
+    if (texts.empty()) {
+        cout << "  no translated events in the corpus" << endl << endl;
+        return;
+    }
+
+    string name = "/ilf_bench_ring_" + to_string(getpid()), error;
+    volatile size_t sink = 0;
+    double throughput_time = time_best([&]() {
+        ILF_RING_WRITER writer;
+        ILF_RING_READER reader;
+        if (!writer.create(name, BENCH_RING_BYTES, error) || !reader.open(name, error))
+            return;
+        thread consumer([&]() {
+            string_view record;
+            while (reader.next(record))
+                sink += record.size();
+        });
+        for (int pass = 0; pass < BENCH_RING_PASSES; pass++) {
+            for (string &text : texts) {
+                while (!writer.try_write(text, false))
+                    this_thread::yield();
+            }
+        }
+        writer.close();
+        consumer.join();
+    });
+    if (!error.empty()) {
+        cout << "  " << error << endl << endl;
+        return;
+    }
+
+    ostringstream per_event;
+    per_event << fixed << setprecision(0) << throughput_time / (texts.size() * BENCH_RING_PASSES) * 1e9 << " ns/event";
+    report("ILF_RING_WRITER to ILF_RING_READER", bytes, throughput_time, per_event.str());
+
+    // each record starts with the time it was written at
+    for (int spin_us : { 0, 1000 }) {
+        ILF_RING_WRITER writer;
+        ILF_RING_READER reader;
+        writer.create(name, BENCH_RING_BYTES, error);
+        reader.open(name, error);
+        reader.set_spin_us(spin_us);
+
+        vector<double> latencies;
+        latencies.reserve(BENCH_RING_LATENCY_SAMPLES);
+        thread consumer([&]() {
+            string_view record;
+            while (reader.next(record)) {
+                long long written;
+                memcpy(&written, record.data(), sizeof(written));
+                long long now = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+                latencies.push_back((now - written) / 1e3);
+            }
+        });
+        string record;
+        for (int i = 0; i < BENCH_RING_LATENCY_SAMPLES; i++) {
+            this_thread::sleep_for(chrono::microseconds(BENCH_RING_LATENCY_GAP_US));
+            long long now = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+            record.assign((const char *) &now, sizeof(now));
+            record += texts[i % texts.size()];
+            writer.try_write(record, true);
+        }
+        writer.close();
+        consumer.join();
+
+        cout << "  " << left << setw(44) << (spin_us == 0 ? "latency, reader sleeping (futex)" : "latency, reader spinning")
+             << right << latency_summary(latencies) << endl;
+    }
+    cout << endl;
+}
+
+// Reads the configuration files given with -f, -m and -e. Returns false, after saying which, if
+// one of them is missing.
+bool read_configs(json &allowed_fields, json &field_mappings, json &event_names)
+{
+    for (auto config : { make_pair(&allowed_fields, allowed_fields_path), make_pair(&field_mappings, field_mappings_path),
+                         make_pair(&event_names, event_names_path) }) {
+        ifstream file(config.second);
+        if (!file) {
+            cout << "  " << config.second << " not found" << endl << endl;
+            return false;
+        }
+        file >> *config.first;
+    }
+    return true;
+}
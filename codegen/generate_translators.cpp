@@ -0,0 +1,279 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+/*
+    Generates C++ translators from the configuration files: one function per event ID, with the
+    ILF keys, field order and quoting compiled in, and a switch dispatching events to them.
+*/
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <iomanip>
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../src/event_plans.h"
+
+using namespace std;
+
+/*
+    Usage:
+        ./generate_translators -f <allowed_fields.json> -m <field_mappings.json> -e <event_names.json> -o <output.cpp>
+
+    Notes:
+        - The configuration files are given as paths, not as names in lib/sysmon_configurations.
+        - The output is compiled with src/generated_translators.h, and selected with "-c generated".
+        - Every named event ID gets a translator; the deny list (-d) still applies at run time.
+*/
+
+void import_config(string path, json &j);
+string literal(string_view s);
+string base_name(const event_plan &plan, size_t index);
+void write_translator(ostream &out, const event_plan &plan, const string &name);
+
+int main (int argc, char *argv[])
+{
+    map<string, string> args;
+    for (int i = 1; i + 1 < argc; i += 2)
+        args[argv[i]] = argv[i + 1];
+
+    if (!args.count("-f") || !args.count("-m") || !args.count("-e") || !args.count("-o")) {
+        cerr << "Usage: " << argv[0] << " -f <allowed_fields.json> -m <field_mappings.json> "
+             << "-e <event_names.json> -o <output.cpp>" << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    json allowed_fields, field_mappings, event_names;
+    import_config(args["-f"], allowed_fields);
+    import_config(args["-m"], field_mappings);
+    import_config(args["-e"], event_names);
+
+    // the same plans the translator compiles at run time, so the generated code can't drift from them
+    EVENT_PLANS plans;
+    if (!plans.compile(event_names, allowed_fields, field_mappings, {}))
+        exit(EXIT_FAILURE);
+    vector<const event_plan *> translated = plans.get_plans();
+
+    vector<string> names;
+    for (size_t i = 0; i < translated.size(); i++)
+        names.push_back(base_name(*translated[i], i));
+
+    ostringstream out;
+    out << "/*" << endl
+        << "    Generated by codegen/generate_translators from:" << endl
+        << "        " << args["-f"] << endl
+        << "        " << args["-m"] << endl
+        << "        " << args["-e"] << endl
+        << "    Do not edit. Regenerate it when the configuration files change." << endl
+        << "*/" << endl
+        << "#include \"generated_translators.h\"" << endl << endl
+        << "using namespace std::literals;" << endl << endl
+        << "namespace {" << endl << endl;
+
+    for (size_t i = 0; i < translated.size(); i++) {
+        const event_plan &plan = *translated[i];
+        if (plan.fields.empty())
+            continue;
+        out << "constexpr string_view " << names[i] << "_sources[] = {" << endl;
+        for (const field_plan &field : plan.fields)
+            out << "    " << literal(field.source) << "," << endl;
+        out << "};" << endl << endl;
+    }
+
+    for (size_t i = 0; i < translated.size(); i++)
+        write_translator(out, *translated[i], names[i]);
+
+    out << "}" << endl << endl;
+
+    out << "const generated_event generated_events[] = {" << endl;
+    for (size_t i = 0; i < translated.size(); i++) {
+        const event_plan &plan = *translated[i];
+        out << "    { " << literal(plan.id) << ", " << literal(plan.event_name) << ", "
+            << (plan.fields.empty() ? "nullptr" : names[i] + "_sources") << ", " << plan.fields.size() << " }," << endl;
+    }
+    // an array can't be empty
+    if (translated.empty())
+        out << "    { \"\"sv, \"\"sv, nullptr, 0 }," << endl;
+    out << "};" << endl
+        << "const size_t generated_event_count = " << translated.size() << ";" << endl << endl;
+
+    out << "const string_view generated_slot_names[] = {" << endl;
+    for (size_t slot = 0; slot < plans.get_slot_count(); slot++)
+        out << "    " << literal(plans.get_slot_name(slot)) << "," << endl;
+    if (plans.get_slot_count() == 0)
+        out << "    \"\"sv," << endl;
+    out << "};" << endl
+        << "const size_t generated_slot_count = " << plans.get_slot_count() << ";" << endl << endl;
+
+    out << "bool translate_generated(string_view id, const sysmon_fields &fields, vector<ilf_attribute> &attributes)" << endl
+        << "{" << endl
+        << "    switch (EVENT_PLANS::table_index(id)) {" << endl;
+    for (size_t i = 0; i < translated.size(); i++) {
+        int index = EVENT_PLANS::table_index(translated[i]->id);
+        if (index < 0)
+            continue;
+        out << "        case " << index << ":" << endl
+            << "            translate_" << names[i] << "(fields, attributes);" << endl
+            << "            return true;" << endl;
+    }
+    out << "        default:" << endl
+        << "            break;" << endl
+        << "    }" << endl << endl;
+    for (size_t i = 0; i < translated.size(); i++) {
+        if (EVENT_PLANS::table_index(translated[i]->id) >= 0)
+            continue;
+        out << "    if (id == " << literal(translated[i]->id) << ") {" << endl
+            << "        translate_" << names[i] << "(fields, attributes);" << endl
+            << "        return true;" << endl
+            << "    }" << endl;
+    }
+    out << "    return false;" << endl
+        << "}" << endl;
+
+    // only replace the output once it is complete, so a failed run doesn't leave half a file that
+    // the build takes as up to date: it is written next to its final path and renamed over it
+    string temporary_path = args["-o"] + ".tmp";
+    ofstream output(temporary_path, ios::trunc);
+    output << out.str();
+    output.close();
+    if (!output) {
+        cerr << "Could not write " << temporary_path << endl;
+        remove(temporary_path.c_str());
+        exit(EXIT_FAILURE);
+    }
+#ifdef _WIN32
+    // rename() doesn't replace an existing file on Windows
+    remove(args["-o"].c_str());
+#endif
+    if (rename(temporary_path.c_str(), args["-o"].c_str()) != 0) {
+        cerr << "Could not replace " << args["-o"] << endl;
+        remove(temporary_path.c_str());
+        exit(EXIT_FAILURE);
+    }
+
+    cout << "Generated translators for " << translated.size() << " event IDs and "
+         << plans.get_slot_count() << " fields in " << args["-o"] << endl;
+    return 0;
+}
+
+// Imports a configuration file. Program exits if there's an issue reading or deserializing it.
+void import_config(string path, json &j)
+{
+    ifstream i(path);
+    if (!i) {
+        cerr << "Could not open " << path << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    try {
+        i >> j;
+    } catch (const json::parse_error &e) {
+        cerr << "Exception in import_config() with path: " << path << ". " << e.what() << endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Returns the string as a C++ string_view literal. Bytes that aren't printable ASCII are
+// written as octal escapes, which always have three digits so the next character can't extend them.
+string literal(string_view s)
+{
+    ostringstream out;
+    out << '"';
+    for (char c : s) {
+        unsigned char u = (unsigned char) c;
+        if (c == '"' || c == '\\')
+            out << '\\' << c;
+        else if (u < 0x20 || u >= 0x7f)
+            out << '\\' << oct << setw(3) << setfill('0') << (int) u << dec;
+        else
+            out << c;
+    }
+    out << "\"sv";
+    return out.str();
+}
+
+// Names the tables and translator of an event after its ID when it is a number, and after its
+// position otherwise
+string base_name(const event_plan &plan, size_t index)
+{
+    int table_index = EVENT_PLANS::table_index(plan.id);
+    return table_index >= 0 ? "event_" + to_string(table_index) : "other_event_" + to_string(index);
+}
+
+// Writes the translator of one event ID: for each of its fields, in order, the lookup of the value
+// in its slot and the attributes appended for it
+void write_translator(ostream &out, const event_plan &plan, const string &name)
+{
+    out << "// EventID " << plan.id << ": " << plan.event_name << endl
+        << "void translate_" << name << "(const sysmon_fields &fields, vector<ilf_attribute> &attributes)" << endl
+        << "{" << endl;
+
+    // a split field without subfields has no attributes
+    vector<const field_plan *> fields;
+    for (const field_plan &field : plan.fields) {
+        if (field.split == SPLIT_NONE || !field.subfields.empty())
+            fields.push_back(&field);
+    }
+
+    if (!fields.empty())
+        out << "    string_view value;" << endl << endl;
+
+    for (const field_plan *f : fields) {
+        const field_plan &field = *f;
+        string quoting = field.quoting == QUOTE_ALWAYS ? "QUOTE_ALWAYS" : "QUOTE_UNLESS_NUMBER";
+        out << "    if (find_value(fields, " << field.slot << ", " << literal(field.source) << ", value))";
+
+        switch (field.split) {
+            case SPLIT_NONE:
+                out << endl
+                    << "        add_value(attributes, " << literal(field.key) << ", value, " << quoting << ");" << endl;
+                break;
+
+            case SPLIT_HASHES: {
+                // the value is split once; the subfields' parts are their positions
+                size_t type_count = min(field.subfields.size(), (size_t) FIELD_SPLIT_MAX_PARTS);
+                out << " {" << endl
+                    << "        constexpr string_view types[] = {";
+                for (size_t i = 0; i < type_count; i++)
+                    out << (i > 0 ? ", " : " ") << literal(field.subfields[i].name);
+                out << " };" << endl
+                    << "        string_view hashes[" << type_count << "];" << endl
+                    << "        split_hashes(value, types, " << type_count << ", hashes);" << endl;
+                for (const subfield_plan &subfield : field.subfields) {
+                    if (subfield.part < 0)
+                        continue;
+                    out << "        if (!hashes[" << subfield.part << "].empty())" << endl
+                        << "            add_value(attributes, " << literal(subfield.key) << ", hashes[" << subfield.part << "], " << quoting << ");" << endl;
+                }
+                out << "    }" << endl;
+                break;
+            }
+
+            case SPLIT_USER:
+                out << " {" << endl
+                    << "        string_view domain, name;" << endl
+                    << "        if (split_user(value, domain, name)) {" << endl;
+                for (const subfield_plan &subfield : field.subfields) {
+                    string subfield_value = "\"\"sv";
+                    if (subfield.part == USER_DOMAIN)
+                        subfield_value = "domain";
+                    else if (subfield.part == USER_NAME)
+                        subfield_value = "name";
+                    out << "            add_value(attributes, " << literal(subfield.key) << ", " << subfield_value << ", " << quoting << ");" << endl;
+                }
+                out << "        }" << endl
+                    << "    }" << endl;
+                break;
+        }
+    }
+
+    out << "}" << endl << endl;
+}
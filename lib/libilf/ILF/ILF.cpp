@@ -7,51 +7,83 @@
 
 #include "ILF.h"
 
-ILF::ILF() {
-    _eventType = "";
-    _sender = "";
-    _receiver = "";
-    _time = "";
-    _pairs = vector<key_val>();
+template <class Allocator>
+basic_ILF<Allocator>::basic_ILF() {
 }
 
-ILF::ILF(string eventType, string sender, string receiver, string time, vector<key_val> pairs) {
-    _eventType = eventType;
-    _sender = sender;
-    _receiver = receiver;
-    _time = time;
-    _pairs = pairs;
+template <class Allocator>
+basic_ILF<Allocator>::basic_ILF(string_type eventType, string_type sender, string_type receiver, string_type time, key_vals_type pairs):
+    _eventType(move(eventType)),
+    _sender(move(sender)),
+    _receiver(move(receiver)),
+    _time(move(time)),
+    _pairs(move(pairs)) {
 }
 
-string ILF::to_string()
+template <class Allocator>
+string basic_ILF<Allocator>::to_string()
 {
-    string s = "";
-    if(_pairs.size() > 0)
-    {
-        for (unsigned int i = 0; i < _pairs.size(); i++)
-        {
-            s += _pairs[i].key + "=" + _pairs[i].value + ";";
-        }
-        s.pop_back();
+    string s;
+    s.reserve(text_size());
+    append_to(s);
+    return s;
+}
+
+// eventType[sender,receiver,time,(key=value;key=value)] with a trailing space
+template <class Allocator>
+void basic_ILF<Allocator>::append_to(string &out) const
+{
+    out.reserve(out.size() + text_size());
+
+    out += _eventType;
+    out += '[';
+    out += _sender;
+    out += ',';
+    out += _receiver;
+    out += ',';
+    out += _time;
+    out += ",(";
+    for (size_t i = 0; i < _pairs.size(); i++) {
+        if (i > 0)
+            out += ';';
+        out += _pairs[i].key;
+        out += '=';
+        out += _pairs[i].value;
     }
-    return _eventType + "[" + _sender + "," + _receiver + "," + _time + ",(" + s + ")] "; 
+    out += ")] ";
 }
 
-string ILF::get_event()
+template <class Allocator>
+size_t basic_ILF<Allocator>::text_size() const
+{
+    // the brackets, commas, parentheses and trailing space
+    size_t size = _eventType.size() + _sender.size() + _receiver.size() + _time.size() + 8;
+    for (const key_val_type &pair : _pairs)
+        size += pair.key.size() + pair.value.size() + 2;
+    return _pairs.empty() ? size : size - 1;
+}
+
+template <class Allocator>
+typename basic_ILF<Allocator>::string_type basic_ILF<Allocator>::get_event()
 {
     return _eventType;
 }
 
-vector<key_val> ILF::get_key_vals()
+template <class Allocator>
+typename basic_ILF<Allocator>::key_vals_type basic_ILF<Allocator>::get_key_vals()
 {
     return _pairs;
 }
 
-void ILF::set_key_vals(vector<key_val> new_vals){
+template <class Allocator>
+void basic_ILF<Allocator>::set_key_vals(key_vals_type new_vals){
     //_pairs = new_vals; // this might only make an alias...
 
     _pairs.clear();
     for(long unsigned int i = 0; i < new_vals.size(); i++){
         _pairs.push_back(new_vals[i]);
     }
-}
\ No newline at end of file
+}
+
+template class basic_ILF<allocator<char>>;
+template class basic_ILF<pmr::polymorphic_allocator<char>>;
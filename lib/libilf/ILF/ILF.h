@@ -7,35 +7,80 @@
 
 #ifndef ILF_H
 #define ILF_H
+#include <memory>
+#include <memory_resource>
 #include <string>
+#include <string_view>
 #include <vector>
 
 using namespace std;
 
-struct key_val {
-    string key;
-    string value;
+// Allocator is the allocator of the strings; key_val and ILF use the global heap, pmr_key_val and
+// pmr_ILF a memory resource, e.g. a monotonic buffer released once a batch of events is done.
+template <class Allocator>
+struct basic_key_val {
+    typedef basic_string<char, char_traits<char>, Allocator> string_type;
+    typedef Allocator allocator_type;
 
-    key_val(string key, string val): key(key), value(val) {}
+    string_type key;
+    string_type value;
+
+    basic_key_val(string_type key, string_type val): key(move(key)), value(move(val)) {}
+
+    // puts the key and value in the given allocator, which is how containers using the allocator
+    // construct them. They are moved when they already are in it.
+    basic_key_val(string_type key, string_type val, const Allocator &allocator): key(move(key), allocator), value(move(val), allocator) {}
+    basic_key_val(const basic_key_val &other, const Allocator &allocator): key(other.key, allocator), value(other.value, allocator) {}
+    basic_key_val(basic_key_val &&other, const Allocator &allocator): key(move(other.key), allocator), value(move(other.value), allocator) {}
+    basic_key_val(const basic_key_val &) = default;
+    basic_key_val(basic_key_val &&) = default;
+    basic_key_val &operator=(const basic_key_val &) = default;
+    basic_key_val &operator=(basic_key_val &&) = default;
 };
 
-class ILF {
+typedef basic_key_val<allocator<char>> key_val;
+typedef basic_key_val<pmr::polymorphic_allocator<char>> pmr_key_val;
+
+template <class Allocator>
+class basic_ILF {
+    public:
+        typedef basic_string<char, char_traits<char>, Allocator> string_type;
+        typedef basic_key_val<Allocator> key_val_type;
+        typedef vector<key_val_type, typename allocator_traits<Allocator>::template rebind_alloc<key_val_type>> key_vals_type;
+
     private:
-        string _eventType;
-        string _sender;
-        string _receiver;
-        string _time;
-        vector<key_val> _pairs;
+        string_type _eventType;
+        string_type _sender;
+        string_type _receiver;
+        string_type _time;
+        key_vals_type _pairs;
 
     public:
-        ILF();
-        ILF(string eventType, string sender, string receiver, string time, vector<key_val> pairs);
+        basic_ILF();
+        // the strings and pairs are moved in, so they keep their allocator
+        basic_ILF(string_type eventType, string_type sender, string_type receiver, string_type time, key_vals_type pairs);
         
         string to_string();
-        string get_event();
-        vector<key_val> get_key_vals();
-        void set_key_vals(vector<key_val> new_vals);
+
+        // Appends the same text as to_string() to out in one pass, so a buffer reused from one
+        // event to the next stops allocating once it has grown to the largest event
+        void append_to(string &out) const;
+
+        // Length of the text of to_string()
+        size_t text_size() const;
+
+        string_type get_event();
+        key_vals_type get_key_vals();
+        const string_type &get_event_type() const { return _eventType; }
+        const string_type &get_sender() const { return _sender; }
+        const string_type &get_receiver() const { return _receiver; }
+        const string_type &get_time() const { return _time; }
+        const key_vals_type &get_pairs() const { return _pairs; }
+        void set_key_vals(key_vals_type new_vals);
 
 };
 
-#endif
\ No newline at end of file
+typedef basic_ILF<allocator<char>> ILF;
+typedef basic_ILF<pmr::polymorphic_allocator<char>> pmr_ILF;
+
+#endif
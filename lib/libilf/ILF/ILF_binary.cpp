@@ -0,0 +1,618 @@
+//  Copyright (c) 2019-2021 The MITRE Corporation. ALL RIGHTS RESERVED.
+//
+//  The Happened-Before Language (HBL) and its detection engine are the
+//  products of The MITRE Corporation, developed with MITRE funds.
+//  This copyright notice must not be removed from this software, absent
+//  MITRE's express written permission.
+
+#include <string.h>
+
+#include "ILF_binary.h"
+
+static const char hex_upper[] = "0123456789ABCDEF";
+static const char hex_lower[] = "0123456789abcdef";
+
+static void put_varint(string &out, uint64_t value)
+{
+    while (value >= 0x80) {
+        out += (char) (value | 0x80);
+        value >>= 7;
+    }
+    out += (char) value;
+}
+
+static void put_signed(string &out, int64_t value)
+{
+    put_varint(out, ((uint64_t) value << 1) ^ (uint64_t) (value >> 63));
+}
+
+static void put_bytes(string &out, string_view bytes)
+{
+    put_varint(out, bytes.size());
+    out.append(bytes.data(), bytes.size());
+}
+
+static bool get_varint(string_view &in, uint64_t &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64 && !in.empty(); shift += 7) {
+        unsigned char byte = in[0];
+        in.remove_prefix(1);
+        value |= (uint64_t) (byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
+
+static bool get_signed(string_view &in, int64_t &value)
+{
+    uint64_t zigzag;
+    if (!get_varint(in, zigzag))
+        return false;
+    value = (int64_t) (zigzag >> 1) ^ -(int64_t) (zigzag & 1);
+    return true;
+}
+
+static bool get_bytes(string_view &in, string_view &bytes)
+{
+    uint64_t length;
+    if (!get_varint(in, length) || length > in.size())
+        return false;
+    bytes = in.substr(0, length);
+    in.remove_prefix(length);
+    return true;
+}
+
+static int hex_digit(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+// days between 1970-01-01 and the given date of the proleptic Gregorian calendar
+static int64_t days_from_civil(int64_t y, unsigned m, unsigned d)
+{
+    y -= m <= 2;
+    int64_t era = (y >= 0 ? y : y - 399) / 400;
+    unsigned yoe = (unsigned) (y - era * 400);
+    unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + (int64_t) doe - 719468;
+}
+
+static void civil_from_days(int64_t z, int64_t &y, unsigned &m, unsigned &d)
+{
+    z += 719468;
+    int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    unsigned doe = (unsigned) (z - era * 146097);
+    unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    unsigned mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = (int64_t) yoe + era * 400 + (m <= 2);
+}
+
+static bool parse_digits(string_view s, size_t start, size_t count, int64_t &value)
+{
+    value = 0;
+    for (size_t i = start; i < start + count; i++) {
+        if (s[i] < '0' || s[i] > '9')
+            return false;
+        value = value * 10 + (s[i] - '0');
+    }
+    return true;
+}
+
+static void put_digits(string &out, int64_t value, int count)
+{
+    char digits[20];
+    for (int i = count - 1; i >= 0; i--) {
+        digits[i] = '0' + value % 10;
+        value /= 10;
+    }
+    out.append(digits, count);
+}
+
+// YYYY-MM-DDTHH:MM:SS[.fraction]Z, with a valid date and time, as the number of fraction units
+// since the Unix epoch. Only text that renders back the same is accepted.
+static bool parse_time(string_view time, int &fraction_digits, int64_t &units)
+{
+    if (time.size() < 20 || time.back() != 'Z' || time[4] != '-' || time[7] != '-' || time[10] != 'T'
+        || time[13] != ':' || time[16] != ':')
+        return false;
+
+    fraction_digits = 0;
+    if (time.size() > 20) {
+        fraction_digits = time.size() - 21;
+        if (time[19] != '.' || fraction_digits < 1 || fraction_digits > 9)
+            return false;
+    }
+
+    int64_t year, month, day, hour, minute, second, fraction = 0;
+    if (!parse_digits(time, 0, 4, year) || !parse_digits(time, 5, 2, month) || !parse_digits(time, 8, 2, day)
+        || !parse_digits(time, 11, 2, hour) || !parse_digits(time, 14, 2, minute) || !parse_digits(time, 17, 2, second)
+        || !parse_digits(time, 20, fraction_digits, fraction))
+        return false;
+
+    static const int month_days[] = { 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    bool leap = year % 4 == 0 && (year % 100 != 0 || year % 400 == 0);
+    if (month < 1 || month > 12 || day < 1 || day > month_days[month - 1] || (month == 2 && day == 29 && !leap)
+        || hour > 23 || minute > 59 || second > 59)
+        return false;
+
+    int64_t scale = 1;
+    for (int i = 0; i < fraction_digits; i++)
+        scale *= 10;
+    int64_t seconds = days_from_civil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+    if (seconds > INT64_MAX / scale || seconds < INT64_MIN / scale + 1)
+        return false;
+    units = seconds * scale + fraction;
+    return true;
+}
+
+static bool render_time(string &out, int fraction_digits, int64_t units)
+{
+    if (fraction_digits > 9)
+        return false;
+    int64_t scale = 1;
+    for (int i = 0; i < fraction_digits; i++)
+        scale *= 10;
+
+    // the fraction is always positive, counted from the second before
+    int64_t seconds = units / scale, fraction = units % scale;
+    if (fraction < 0) {
+        seconds--;
+        fraction += scale;
+    }
+    int64_t days = seconds / 86400, in_day = seconds % 86400;
+    if (in_day < 0) {
+        days--;
+        in_day += 86400;
+    }
+
+    int64_t year;
+    unsigned month, day;
+    civil_from_days(days, year, month, day);
+    if (year < 0 || year > 9999)
+        return false;
+
+    put_digits(out, year, 4);
+    out += '-';
+    put_digits(out, month, 2);
+    out += '-';
+    put_digits(out, day, 2);
+    out += 'T';
+    put_digits(out, in_day / 3600, 2);
+    out += ':';
+    put_digits(out, in_day / 60 % 60, 2);
+    out += ':';
+    put_digits(out, in_day % 60, 2);
+    if (fraction_digits > 0) {
+        out += '.';
+        put_digits(out, fraction, fraction_digits);
+    }
+    out += 'Z';
+    return true;
+}
+
+// "0", or digits without leading zeros, possibly negative, that fit in 64 bits
+static bool parse_int(string_view value, int64_t &number)
+{
+    bool negative = !value.empty() && value[0] == '-';
+    string_view digits = value.substr(negative);
+    if (digits.empty() || digits.size() > 18 || (digits[0] == '0' && (digits.size() > 1 || negative)))
+        return false;
+
+    int64_t magnitude;
+    if (!parse_digits(digits, 0, digits.size(), magnitude))
+        return false;
+    number = negative ? -magnitude : magnitude;
+    return true;
+}
+
+// Hashes the length and the first and last 8 bytes, which tell the keys and event types apart
+// without reading all of them; strings that share them only make the probes longer
+static uint32_t hash_string(string_view s)
+{
+    uint64_t first = 0, last = 0;
+    size_t n = s.size() < 8 ? s.size() : 8;
+    if (n > 0) {
+        memcpy(&first, s.data(), n);
+        memcpy(&last, s.data() + s.size() - n, n);
+    }
+    uint64_t h = (first * 0x9E3779B97F4A7C15ull) ^ (last * 0xC2B2AE3D27D4EB4Full) ^ s.size();
+    return (uint32_t) (h ^ (h >> 29) ^ (h >> 47));
+}
+
+// The table is kept at most half full, so probes stay short
+uint32_t ILF_ENCODER::intern(string_view s)
+{
+    if (table.size() < (strings.size() + 1) * 2) {
+        table.assign(table.empty() ? 64 : table.size() * 2, 0);
+        for (uint32_t id = 0; id < strings.size(); id++) {
+            size_t slot = hash_string(strings[id]) & (table.size() - 1);
+            while (table[slot] != 0)
+                slot = (slot + 1) & (table.size() - 1);
+            table[slot] = id + 1;
+        }
+    }
+
+    size_t slot = hash_string(s) & (table.size() - 1);
+    for (; table[slot] != 0; slot = (slot + 1) & (table.size() - 1)) {
+        if (strings[table[slot] - 1] == s)
+            return table[slot] - 1;
+    }
+
+    table[slot] = strings.size() + 1;
+    strings.emplace_back(s);
+    return strings.size() - 1;
+}
+
+void ILF_ENCODER::begin(string &out)
+{
+    started = true;
+    out.append(ILF_BINARY_MAGIC, ILF_BINARY_MAGIC_LEN);
+    out += (char) ILF_BINARY_VERSION;
+    send_strings(out);
+}
+
+// Sends the strings added since the last frame in a dictionary frame
+void ILF_ENCODER::send_strings(string &out)
+{
+    if (sent == strings.size())
+        return;
+
+    string dictionary;
+    dictionary += (char) ILF_FRAME_DICTIONARY;
+    put_varint(dictionary, sent);
+    put_varint(dictionary, strings.size() - sent);
+    for (; sent < strings.size(); sent++)
+        put_bytes(dictionary, strings[sent]);
+    put_bytes(out, dictionary);
+}
+
+void ILF_ENCODER::start_event(string_view event_type, string_view sender, string_view receiver, string_view time)
+{
+    body.clear();
+    pairs.clear();
+    pair_count = 0;
+
+    body += (char) ILF_FRAME_EVENT;
+    put_varint(body, intern(event_type));
+    put_varint(body, intern(sender));
+    put_varint(body, intern(receiver));
+
+    int fraction_digits;
+    int64_t units;
+    if (parse_time(time, fraction_digits, units)) {
+        body += (char) (ILF_TIME_EPOCH + fraction_digits);
+        put_signed(body, units);
+    } else {
+        body += (char) ILF_TIME_TEXT;
+        put_bytes(body, time);
+    }
+}
+
+void ILF_ENCODER::add_key(string_view key)
+{
+    pair_count++;
+    put_varint(pairs, intern(key));
+}
+
+void ILF_ENCODER::add_bare(string_view key, string_view value)
+{
+    add_key(key);
+
+    int64_t number;
+    if (parse_int(value, number)) {
+        pairs += (char) ILF_VALUE_INT;
+        put_signed(pairs, number);
+    } else {
+        pairs += (char) ILF_VALUE_RAW;
+        put_bytes(pairs, value);
+    }
+}
+
+// Hex strings with an even number of digits, all in the same case, are sent as bytes
+void ILF_ENCODER::add_quoted(string_view key, string_view value)
+{
+    add_key(key);
+
+    bool hex = !value.empty() && value.size() % 2 == 0;
+    bool upper = false, lower = false;
+    for (size_t i = 0; i < value.size() && hex; i++) {
+        char c = value[i];
+        hex = hex_digit(c) >= 0;
+        upper = upper || (c >= 'A' && c <= 'F');
+        lower = lower || (c >= 'a' && c <= 'f');
+    }
+
+    if (!hex || (upper && lower)) {
+        pairs += (char) ILF_VALUE_STRING;
+        put_bytes(pairs, value);
+        return;
+    }
+
+    pairs += (char) (lower ? ILF_VALUE_HASH_LOWER : ILF_VALUE_HASH_UPPER);
+    put_varint(pairs, value.size() / 2);
+    for (size_t i = 0; i < value.size(); i += 2)
+        pairs += (char) (hex_digit(value[i]) << 4 | hex_digit(value[i + 1]));
+}
+
+void ILF_ENCODER::end_event(string &out)
+{
+    if (!started)
+        begin(out);
+
+    send_strings(out);
+
+    put_varint(body, pair_count);
+    put_varint(out, body.size() + pairs.size());
+    out += body;
+    out += pairs;
+}
+
+// Values that are quoted and escaped the way the translator does it are sent unescaped, other
+// values as they are
+void ILF_ENCODER::encode(const ILF &ilf, string &out)
+{
+    start_event(ilf.get_event_type(), ilf.get_sender(), ilf.get_receiver(), ilf.get_time());
+
+    for (const key_val &pair : ilf.get_pairs()) {
+        const string &value = pair.value;
+        bool quoted = value.size() >= 2 && value.front() == '"' && value.back() == '"';
+        if (quoted) {
+            // the characters between two escapes are copied at once
+            unescaped.clear();
+            const char *run = value.data() + 1, *end = value.data() + value.size() - 1;
+            for (const char *p = run; p < end && quoted; p++) {
+                if (*p != '"' && *p != '\\')
+                    continue;
+                quoted = *p == '\\' && p + 1 < end && (p[1] == '"' || p[1] == '\\');
+                unescaped.append(run, p);
+                run = ++p;
+            }
+            unescaped.append(run, end);
+        }
+
+        if (quoted)
+            add_quoted(pair.key, unescaped);
+        else
+            add_bare(pair.key, value);
+    }
+
+    end_event(out);
+}
+
+bool ILF_DECODER::failed() const
+{
+    return error;
+}
+
+bool ILF_DECODER::fail()
+{
+    error = true;
+    return false;
+}
+
+bool ILF_DECODER::read_header(string_view &in)
+{
+    if (in.size() < ILF_BINARY_MAGIC_LEN + 1 || in.substr(0, ILF_BINARY_MAGIC_LEN) != ILF_BINARY_MAGIC
+        || in[ILF_BINARY_MAGIC_LEN] != ILF_BINARY_VERSION)
+        return fail();
+    in.remove_prefix(ILF_BINARY_MAGIC_LEN + 1);
+    started = true;
+    return true;
+}
+
+// Reads frames up to the next event, adding the strings of dictionary frames on the way
+bool ILF_DECODER::next_event(string_view &in, string_view &event)
+{
+    if (error || (!started && !read_header(in)))
+        return false;
+
+    while (!in.empty()) {
+        // a header between two frames starts a stream appended to this one, with its own
+        // dictionary. It can't be taken for a frame: its second byte isn't a frame type.
+        if (in.substr(0, ILF_BINARY_MAGIC_LEN) == ILF_BINARY_MAGIC) {
+            strings.clear();
+            if (!read_header(in))
+                return false;
+            continue;
+        }
+
+        string_view frame;
+        if (!get_bytes(in, frame) || frame.empty())
+            return fail();
+
+        char type = frame[0];
+        frame.remove_prefix(1);
+        if (type == ILF_FRAME_EVENT) {
+            event = frame;
+            return true;
+        }
+        if (type != ILF_FRAME_DICTIONARY)
+            return fail();
+
+        uint64_t first, count;
+        if (!get_varint(frame, first) || !get_varint(frame, count) || first != strings.size())
+            return fail();
+        for (uint64_t i = 0; i < count; i++) {
+            string_view s;
+            if (!get_bytes(frame, s))
+                return fail();
+            strings.emplace_back(s);
+        }
+        if (!frame.empty())
+            return fail();
+    }
+    return false;
+}
+
+// Reads an event, giving output its header with the time rendered as text, then each pair with the
+// value type and its payload (the varint for integers, the bytes otherwise)
+template <class Output>
+bool ILF_DECODER::read_event(string_view event, Output &output)
+{
+    uint64_t type_id, sender_id, receiver_id;
+    if (!get_varint(event, type_id) || !get_varint(event, sender_id) || !get_varint(event, receiver_id)
+        || type_id >= strings.size() || sender_id >= strings.size() || receiver_id >= strings.size() || event.empty())
+        return fail();
+
+    uint8_t time_kind = event[0];
+    event.remove_prefix(1);
+    string &time = output.start(strings[type_id], strings[sender_id], strings[receiver_id]);
+    if (time_kind == ILF_TIME_TEXT) {
+        string_view text;
+        if (!get_bytes(event, text))
+            return fail();
+        time.append(text.data(), text.size());
+    } else {
+        int64_t units;
+        if (!get_signed(event, units) || !render_time(time, time_kind - ILF_TIME_EPOCH, units))
+            return fail();
+    }
+    output.end_time();
+
+    uint64_t pair_count;
+    if (!get_varint(event, pair_count))
+        return fail();
+    for (uint64_t i = 0; i < pair_count; i++) {
+        uint64_t key_id;
+        if (!get_varint(event, key_id) || key_id >= strings.size() || event.empty())
+            return fail();
+        uint8_t value_type = event[0];
+        event.remove_prefix(1);
+
+        string &value = output.start_pair(strings[key_id]);
+        int64_t number;
+        string_view bytes;
+        if (value_type == ILF_VALUE_INT) {
+            if (!get_signed(event, number))
+                return fail();
+            uint64_t magnitude = number < 0 ? 0 - (uint64_t) number : number;
+            if (number < 0)
+                value += '-';
+            char digits[20];
+            int count = 0;
+            do {
+                digits[count++] = '0' + magnitude % 10;
+                magnitude /= 10;
+            } while (magnitude > 0);
+            while (count > 0)
+                value += digits[--count];
+        } else if (value_type > ILF_VALUE_HASH_LOWER || !get_bytes(event, bytes)) {
+            return fail();
+        } else if (value_type == ILF_VALUE_RAW) {
+            value.append(bytes.data(), bytes.size());
+        } else if (value_type == ILF_VALUE_STRING) {
+            // quoted and escaped like std::quoted does
+            value += '"';
+            const char *run = bytes.data(), *end = run + bytes.size();
+            for (const char *p = run; p < end; p++) {
+                if (*p == '"' || *p == '\\') {
+                    value.append(run, p);
+                    value += '\\';
+                    run = p;
+                }
+            }
+            value.append(run, end);
+            value += '"';
+        } else {
+            const char *digits = value_type == ILF_VALUE_HASH_LOWER ? hex_lower : hex_upper;
+            value += '"';
+            for (unsigned char byte : bytes) {
+                value += digits[byte >> 4];
+                value += digits[byte & 0xf];
+            }
+            value += '"';
+        }
+        output.end_pair();
+    }
+    return event.empty() ? true : fail();
+}
+
+// Builds an ILF from the decoded event
+struct ilf_output {
+    string type, sender, receiver, time;
+    vector<key_val> pairs;
+
+    string &start(const string &event_type, const string &event_sender, const string &event_receiver)
+    {
+        type = event_type;
+        sender = event_sender;
+        receiver = event_receiver;
+        return time;
+    }
+    void end_time() {}
+    string &start_pair(const string &key)
+    {
+        pairs.push_back(key_val(key, ""));
+        return pairs.back().value;
+    }
+    void end_pair() {}
+};
+
+// Writes the decoded event as text: eventType[sender,receiver,time,(key=value;key=value)]
+struct text_output {
+    string &text;
+    bool first_pair = true;
+
+    string &start(const string &event_type, const string &sender, const string &receiver)
+    {
+        text += event_type;
+        text += '[';
+        text += sender;
+        text += ',';
+        text += receiver;
+        text += ',';
+        return text;
+    }
+    void end_time()
+    {
+        text += ",(";
+    }
+    string &start_pair(const string &key)
+    {
+        if (!first_pair)
+            text += ';';
+        first_pair = false;
+        text += key;
+        text += '=';
+        return text;
+    }
+    void end_pair() {}
+};
+
+bool ILF_DECODER::next(string_view &in, ILF &ilf)
+{
+    string_view event;
+    ilf_output output;
+    if (!next_event(in, event) || !read_event(event, output))
+        return false;
+    ilf = ILF(move(output.type), move(output.sender), move(output.receiver), move(output.time), move(output.pairs));
+    return true;
+}
+
+// The text is only appended to if the event is decoded in full
+bool ILF_DECODER::next_text(string_view &in, string &text)
+{
+    string_view event;
+    size_t size = text.size();
+    text_output output = { text };
+    if (!next_event(in, event))
+        return false;
+    if (!read_event(event, output)) {
+        text.resize(size);
+        return false;
+    }
+    text += ")] ";
+    return true;
+}
@@ -0,0 +1,120 @@
+//  Copyright (c) 2019-2021 The MITRE Corporation. ALL RIGHTS RESERVED.
+//
+//  The Happened-Before Language (HBL) and its detection engine are the
+//  products of The MITRE Corporation, developed with MITRE funds.
+//  This copyright notice must not be removed from this software, absent
+//  MITRE's express written permission.
+
+#ifndef ILF_BINARY_H
+#define ILF_BINARY_H
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ILF.h"
+
+using namespace std;
+
+/*
+    Binary encoding of a stream of ILF events, decoded back to the exact text of ILF::to_string().
+
+    A stream starts with ILF_BINARY_MAGIC and a version byte, followed by frames. Each frame is its
+    length (varint) and then its type:
+        'D' dictionary: id of the first string (varint), count (varint), strings
+        'E' event: type, sender and receiver ids (varints), time, pair count (varint), then for each
+            pair the key id (varint) and a typed value
+    Strings are interned: each one is sent once, in a dictionary frame before the first event using
+    it, and events refer to it by id. Strings and bytes are a length (varint) followed by the bytes;
+    varints are unsigned LEB128, and signed values are zigzag-encoded first. Streams may be
+    concatenated, e.g. by appending each run to the same file: the decoder takes a header between
+    two frames as the start of a new stream, and starts its dictionary over.
+
+    Times of the form YYYY-MM-DDTHH:MM:SS[.fraction]Z are sent as the number of fraction units
+    since the Unix epoch, other times as strings. Values are typed when their text can be rebuilt
+    from the type: canonical decimal integers, quoted hex strings (hashes) as their bytes, other
+    quoted strings without their quotes and escapes; anything else is sent as its raw text.
+*/
+
+#define ILF_BINARY_MAGIC "ILFB"
+#define ILF_BINARY_MAGIC_LEN 4
+#define ILF_BINARY_VERSION 1
+
+enum ilf_frame_type : uint8_t {
+    ILF_FRAME_DICTIONARY = 'D',
+    ILF_FRAME_EVENT = 'E'
+};
+
+// The time field starts with ILF_TIME_TEXT or ILF_TIME_EPOCH plus the number of fraction digits
+enum ilf_time_kind : uint8_t {
+    ILF_TIME_TEXT = 0,
+    ILF_TIME_EPOCH = 1
+};
+
+enum ilf_value_type : uint8_t {
+    ILF_VALUE_RAW = 0,          // bare text, as it is
+    ILF_VALUE_INT = 1,          // bare canonical decimal integer, zigzag varint
+    ILF_VALUE_STRING = 2,       // quoted string, unescaped
+    ILF_VALUE_HASH_UPPER = 3,   // quoted hex string with upper case (or no) letters, as bytes
+    ILF_VALUE_HASH_LOWER = 4    // quoted hex string with lower case letters, as bytes
+};
+
+class ILF_ENCODER {
+    public:
+        // Adds a string to the dictionary, e.g. the keys and event types known in advance, so that
+        // they are all sent at the start of the stream. Returns its id.
+        uint32_t intern(string_view s);
+
+        // Appends the start of the stream: the magic, the version, and the strings interned so far.
+        // The first event appended does it if it hasn't been done.
+        void begin(string &out);
+
+        // Appends an event, preceded by the strings it adds to the dictionary if there are any
+        void encode(const ILF &ilf, string &out);
+
+        // Builds an event from its parts, for callers that don't have an ILF: start_event(), then
+        // the pairs, then end_event(). Values are given as they are before being quoted.
+        void start_event(string_view event_type, string_view sender, string_view receiver, string_view time);
+        void add_bare(string_view key, string_view value);
+        void add_quoted(string_view key, string_view value);
+        void end_event(string &out);
+
+    private:
+        vector<string> strings;             // by id
+        vector<uint32_t> table;             // open addressing: id + 1 of each string, 0 if empty
+        size_t sent = 0;                    // strings already sent in a dictionary frame
+        bool started = false;
+
+        string body;                        // payload of the event being built, up to its pairs
+        string pairs;
+        uint32_t pair_count = 0;
+        string unescaped;
+
+        void add_key(string_view key);
+        void send_strings(string &out);
+};
+
+class ILF_DECODER {
+    public:
+        // Decodes the next event of the stream, consuming in up to the end of it. Returns false at
+        // the end of the stream, or if it is malformed (then failed() is true). A stream can be
+        // decoded in pieces as long as each piece ends between two frames.
+        bool next(string_view &in, ILF &ilf);
+
+        // Same as next(), appending the text of the event (ILF::to_string()) instead
+        bool next_text(string_view &in, string &text);
+
+        bool failed() const;
+
+    private:
+        vector<string> strings;
+        bool started = false;
+        bool error = false;
+
+        bool read_header(string_view &in);
+        bool next_event(string_view &in, string_view &event);
+        template <class Output> bool read_event(string_view event, Output &output);
+        bool fail();
+};
+
+#endif
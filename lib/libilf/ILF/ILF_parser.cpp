@@ -0,0 +1,253 @@
+//  Copyright (c) 2019-2021 The MITRE Corporation. ALL RIGHTS RESERVED.
+//
+//  The Happened-Before Language (HBL) and its detection engine are the
+//  products of The MITRE Corporation, developed with MITRE funds.
+//  This copyright notice must not be removed from this software, absent
+//  MITRE's express written permission.
+
+// The vector kernels are compiled for their instruction set with target attributes and chosen at
+// runtime, so the rest of the library is built for the baseline architecture. Other compilers and
+// architectures use the scalar kernel.
+
+#include <stdint.h>
+#include <string.h>
+
+#include "ILF_parser.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define ILF_PARSER_X86
+#include <immintrin.h>
+#endif
+
+typedef const char *(*find_function)(const char *, const char *, char, char);
+
+// Returns a pointer to the first a or b in [p, end), or end if there is none
+static const char *find_either_scalar(const char *p, const char *end, char a, char b)
+{
+    while (p < end && *p != a && *p != b)
+        p++;
+    return p;
+}
+
+#ifdef ILF_PARSER_X86
+
+__attribute__((target("sse2")))
+static const char *find_either_sse2(const char *p, const char *end, char a, char b)
+{
+    const __m128i va = _mm_set1_epi8(a);
+    const __m128i vb = _mm_set1_epi8(b);
+    for (; end - p >= 16; p += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i *) p);
+        uint32_t mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(block, va), _mm_cmpeq_epi8(block, vb)));
+        if (mask != 0)
+            return p + __builtin_ctz(mask);
+    }
+    return find_either_scalar(p, end, a, b);
+}
+
+__attribute__((target("avx2")))
+static const char *find_either_avx2(const char *p, const char *end, char a, char b)
+{
+    const __m256i va = _mm256_set1_epi8(a);
+    const __m256i vb = _mm256_set1_epi8(b);
+    for (; end - p >= 32; p += 32) {
+        __m256i block = _mm256_loadu_si256((const __m256i *) p);
+        uint32_t mask = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(block, va), _mm256_cmpeq_epi8(block, vb)));
+        if (mask != 0)
+            return p + __builtin_ctz(mask);
+    }
+    return find_either_sse2(p, end, a, b);
+}
+
+#endif
+
+static bool is_supported(ilf_parse_kernel kernel)
+{
+#ifdef ILF_PARSER_X86
+    // may run from a static initializer, before the runtime has probed the CPU
+    __builtin_cpu_init();
+#endif
+    switch (kernel) {
+        case ILF_PARSE_SCALAR:
+            return true;
+#ifdef ILF_PARSER_X86
+        case ILF_PARSE_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case ILF_PARSE_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+static find_function get_find_function(ilf_parse_kernel kernel)
+{
+    switch (kernel) {
+#ifdef ILF_PARSER_X86
+        case ILF_PARSE_SSE2:
+            return find_either_sse2;
+        case ILF_PARSE_AVX2:
+            return find_either_avx2;
+#endif
+        default:
+            return find_either_scalar;
+    }
+}
+
+static ilf_parse_kernel best_parse_kernel()
+{
+    if (is_supported(ILF_PARSE_AVX2))
+        return ILF_PARSE_AVX2;
+    if (is_supported(ILF_PARSE_SSE2))
+        return ILF_PARSE_SSE2;
+    return ILF_PARSE_SCALAR;
+}
+
+// constant-initialized, so the scalar kernel is usable even before the best one is selected
+static ilf_parse_kernel current_kernel = ILF_PARSE_SCALAR;
+static find_function find_either = find_either_scalar;
+
+ilf_parse_kernel get_ilf_parse_kernel()
+{
+    return current_kernel;
+}
+
+const char *get_ilf_parse_kernel_name(ilf_parse_kernel kernel)
+{
+    switch (kernel) {
+        case ILF_PARSE_SSE2:
+            return "sse2";
+        case ILF_PARSE_AVX2:
+            return "avx2";
+        default:
+            return "scalar";
+    }
+}
+
+bool set_ilf_parse_kernel(ilf_parse_kernel kernel)
+{
+    if (!is_supported(kernel))
+        return false;
+    current_kernel = kernel;
+    find_either = get_find_function(kernel);
+    return true;
+}
+
+static bool best_kernel_selected = set_ilf_parse_kernel(best_parse_kernel());
+
+static bool is_space(char c)
+{
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+// Reads up to the delimiter, which is consumed, into field
+static bool read_until(const char *&p, const char *end, char delimiter, string_view &field)
+{
+    const char *found = (const char *) memchr(p, delimiter, end - p);
+    if (found == nullptr)
+        return false;
+    field = string_view(p, found - p);
+    p = found + 1;
+    return true;
+}
+
+// eventType[sender,receiver,time,(key=value;key=value)]
+bool ILF_PARSER::parse_event(const char *&p, const char *end)
+{
+    pairs.clear();
+    if (!read_until(p, end, '[', event_type) || !read_until(p, end, ',', sender)
+        || !read_until(p, end, ',', receiver) || !read_until(p, end, ',', time) || p == end || *p++ != '(')
+        return false;
+
+    if (p < end && *p == ')') {
+        p++;
+        return p < end && *p++ == ']';
+    }
+
+    while (true) {
+        ilf_text_pair pair;
+        if (!read_until(p, end, '=', pair.key) || p == end)
+            return false;
+
+        const char *value = p;
+        if (*p == '"') {
+            // to the closing quote, skipping escaped characters
+            p++;
+            while ((p = find_either(p, end, '"', '\\')) < end && *p == '\\')
+                p += 2;
+            if (p >= end)
+                return false;
+            p++;
+        } else {
+            p = find_either(p, end, ';', ')');
+        }
+        if (p >= end)
+            return false;
+        pair.value = string_view(value, p - value);
+        pairs.push_back(pair);
+
+        if (*p == ';') {
+            p++;
+            continue;
+        }
+        p++;
+        return *(p - 1) == ')' && p < end && *p++ == ']';
+    }
+}
+
+bool ILF_PARSER::parse(string_view text)
+{
+    const char *p = text.data(), *end = p + text.size();
+    if (!parse_event(p, end))
+        return false;
+    while (p < end && is_space(*p))
+        p++;
+    return p == end;
+}
+
+bool ILF_PARSER::next(string_view &text)
+{
+    const char *p = text.data(), *end = p + text.size();
+    while (p < end && is_space(*p))
+        p++;
+    text.remove_prefix(p - text.data());
+    if (p == end || !parse_event(p, end))
+        return false;
+    while (p < end && is_space(*p))
+        p++;
+    text.remove_prefix(p - text.data());
+    return true;
+}
+
+ILF ILF_PARSER::to_ilf() const
+{
+    vector<key_val> key_vals;
+    key_vals.reserve(pairs.size());
+    for (const ilf_text_pair &pair : pairs)
+        key_vals.push_back(key_val(string(pair.key), string(pair.value)));
+    return ILF(string(event_type), string(sender), string(receiver), string(time), move(key_vals));
+}
+
+bool ILF_PARSER::is_quoted(string_view value)
+{
+    return value.size() >= 2 && value.front() == '"' && value.back() == '"';
+}
+
+void ILF_PARSER::unquote(string_view value, string &out)
+{
+    if (!is_quoted(value)) {
+        out.append(value.data(), value.size());
+        return;
+    }
+
+    // the characters between two escapes are appended at once
+    const char *run = value.data() + 1, *end = value.data() + value.size() - 1;
+    for (const char *p = run; p < end; p++) {
+        if (*p == '\\' && p + 1 < end) {
+            out.append(run, p);
+            run = ++p;
+        }
+    }
+    out.append(run, end);
+}
@@ -0,0 +1,68 @@
+//  Copyright (c) 2019-2021 The MITRE Corporation. ALL RIGHTS RESERVED.
+//
+//  The Happened-Before Language (HBL) and its detection engine are the
+//  products of The MITRE Corporation, developed with MITRE funds.
+//  This copyright notice must not be removed from this software, absent
+//  MITRE's express written permission.
+
+#ifndef ILF_PARSER_H
+#define ILF_PARSER_H
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "ILF.h"
+
+using namespace std;
+
+// Implementations of the delimiter search. The fastest one supported by the CPU is picked at
+// startup; the others are kept selectable for tests and benchmarks.
+enum ilf_parse_kernel { ILF_PARSE_SCALAR, ILF_PARSE_SSE2, ILF_PARSE_AVX2 };
+
+ilf_parse_kernel get_ilf_parse_kernel();
+const char *get_ilf_parse_kernel_name(ilf_parse_kernel kernel);
+
+// Selects the kernel used by the parsers. Returns false if the CPU doesn't support it.
+bool set_ilf_parse_kernel(ilf_parse_kernel kernel);
+
+// A key and its value as written: quoted values keep their quotes and escapes
+struct ilf_text_pair {
+    string_view key;
+    string_view value;
+};
+
+/*
+    Parser of the text of ILF::to_string(), eventType[sender,receiver,time,(key=value;key=value)],
+    into views of the text, which must outlive them. Quoted values may hold any character, with
+    quotes and backslashes escaped; bare values end at the first ';' or ')'. Nothing is allocated
+    once pairs has grown to the largest event.
+*/
+class ILF_PARSER {
+    public:
+        string_view event_type;
+        string_view sender;
+        string_view receiver;
+        string_view time;
+        vector<ilf_text_pair> pairs;
+
+        // Parses a single event, with or without the whitespace that follows it. Returns false if
+        // it is malformed.
+        bool parse(string_view text);
+
+        // Parses the next event of text holding several, separated by whitespace (e.g. the
+        // translator's output), and consumes it. Returns false at the end of the text, or if the
+        // event is malformed (then text is left where the event starts).
+        bool next(string_view &text);
+
+        ILF to_ilf() const;
+
+        static bool is_quoted(string_view value);
+
+        // Appends the value without its quotes and escapes, or as it is if it isn't quoted
+        static void unquote(string_view value, string &out);
+
+    private:
+        bool parse_event(const char *&p, const char *end);
+};
+
+#endif
@@ -0,0 +1,325 @@
+//  Copyright (c) 2019-2021 The MITRE Corporation. ALL RIGHTS RESERVED.
+//
+//  The Happened-Before Language (HBL) and its detection engine are the
+//  products of The MITRE Corporation, developed with MITRE funds.
+//  This copyright notice must not be removed from this software, absent
+//  MITRE's express written permission.
+
+#ifndef _WIN32
+
+#include <chrono>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#endif
+
+#include "ILF_ring.h"
+
+static_assert(atomic<uint64_t>::is_always_lock_free && atomic<uint32_t>::is_always_lock_free,
+              "the ring's indices are shared between processes");
+
+#define ILF_RING_RECORD_ALIGNMENT 8
+#define ILF_RING_MIN_CAPACITY 4096
+
+// the data area starts on its own cache line
+static const size_t header_bytes = (sizeof(ilf_ring_header) + ILF_RING_CACHE_LINE - 1) / ILF_RING_CACHE_LINE * ILF_RING_CACHE_LINE;
+
+static void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+// Sleeps while the futex word holds value, for at most timeout_ms (-1: no limit)
+static void futex_wait(atomic<uint32_t> &word, uint32_t value, int timeout_ms)
+{
+#ifdef __linux__
+    struct timespec timeout = { timeout_ms / 1000, (timeout_ms % 1000) * 1000000L };
+    syscall(SYS_futex, (uint32_t *) &word, FUTEX_WAIT, value, timeout_ms < 0 ? nullptr : &timeout, nullptr, 0);
+#else
+    if (word.load(memory_order_acquire) == value)
+        this_thread::sleep_for(chrono::milliseconds(timeout_ms < 0 || timeout_ms > 1 ? 1 : timeout_ms));
+#endif
+}
+
+static void futex_wake(atomic<uint32_t> &word)
+{
+#ifdef __linux__
+    syscall(SYS_futex, (uint32_t *) &word, FUTEX_WAKE, 1, nullptr, nullptr, 0);
+#endif
+}
+
+ILF_RING_WRITER::~ILF_RING_WRITER()
+{
+    close();
+}
+
+bool ILF_RING_WRITER::create(const string &ring_name, size_t capacity, string &error)
+{
+    size_t size = ILF_RING_MIN_CAPACITY;
+    while (size < capacity)
+        size <<= 1;
+
+    // a reader still mapping a ring left behind keeps it, but can't be handed the new one
+    shm_unlink(ring_name.c_str());
+    int fd = shm_open(ring_name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0660);
+    if (fd < 0) {
+        error = "Error creating the shared memory ring " + ring_name + ": " + strerror(errno);
+        return false;
+    }
+    void *memory = MAP_FAILED;
+    if (ftruncate(fd, header_bytes + size) == 0)
+        memory = mmap(nullptr, header_bytes + size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+        error = "Error mapping the shared memory ring " + ring_name + ": " + strerror(errno);
+        shm_unlink(ring_name.c_str());
+        return false;
+    }
+
+    // the new object is zeroed, so the indices and flags start at 0
+    name = ring_name;
+    mapped = header_bytes + size;
+    header = (ilf_ring_header *) memory;
+    data = (char *) memory + header_bytes;
+    header->version = ILF_RING_VERSION;
+    header->record_alignment = ILF_RING_RECORD_ALIGNMENT;
+    header->capacity = size;
+    head = cached_tail = 0;
+
+    // readers check the magic before anything else
+    atomic_thread_fence(memory_order_release);
+    memcpy(header->magic, ILF_RING_MAGIC, sizeof(header->magic));
+    return true;
+}
+
+bool ILF_RING_WRITER::try_write(string_view record, bool drop)
+{
+    if (header == nullptr)
+        return false;
+    uint64_t capacity = header->capacity;
+    size_t size = record_bytes(record.size());
+    size_t offset = head & (capacity - 1);
+    size_t to_end = capacity - offset;
+
+    // a record that doesn't fit before the end of the data area starts at its beginning. The end is
+    // skipped as soon as it is free, on its own, so that the record only waits for its own bytes:
+    // waiting for both could be waiting for more than the ring holds.
+    if (size <= capacity && size > to_end && has_room(to_end)) {
+        uint32_t wrap = ILF_RING_WRAP;
+        memcpy(data + offset, &wrap, 4);
+        head += to_end;
+        header->head.store(head, memory_order_release);
+        wake_reader();
+        offset = 0;
+        to_end = capacity;
+    }
+
+    if (size > to_end || !has_room(size)) {
+        if (drop)
+            header->dropped.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+
+    uint32_t length = record.size();
+    memcpy(data + offset, &length, 4);
+    memcpy(data + offset + 4, record.data(), record.size());
+    head += size;
+    header->head.store(head, memory_order_release);
+
+    wake_reader();
+    return true;
+}
+
+// the reader's cache line is only read when the tail seen last doesn't leave room
+bool ILF_RING_WRITER::has_room(size_t bytes)
+{
+    uint64_t capacity = header->capacity;
+    if (head + bytes - cached_tail <= capacity)
+        return true;
+    cached_tail = header->tail.load(memory_order_acquire);
+    return head + bytes - cached_tail <= capacity;
+}
+
+// Either the reader sees the new head before sleeping, or this sees that it sleeps
+void ILF_RING_WRITER::wake_reader()
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    if (header->reader_sleeping.load(memory_order_relaxed)) {
+        header->wakeups.fetch_add(1, memory_order_release);
+        futex_wake(header->wakeups);
+    }
+}
+
+void ILF_RING_WRITER::close()
+{
+    if (header == nullptr)
+        return;
+    header->closed.store(1, memory_order_release);
+    header->wakeups.fetch_add(1, memory_order_release);
+    futex_wake(header->wakeups);
+
+    munmap(header, mapped);
+    shm_unlink(name.c_str());
+    header = nullptr;
+    data = nullptr;
+}
+
+uint64_t ILF_RING_WRITER::get_dropped() const
+{
+    return header == nullptr ? 0 : header->dropped.load(memory_order_relaxed);
+}
+
+uint64_t ILF_RING_WRITER::get_capacity() const
+{
+    return header == nullptr ? 0 : header->capacity;
+}
+
+size_t ILF_RING_WRITER::record_bytes(size_t size)
+{
+    return (4 + size + ILF_RING_RECORD_ALIGNMENT - 1) / ILF_RING_RECORD_ALIGNMENT * ILF_RING_RECORD_ALIGNMENT;
+}
+
+ILF_RING_READER::~ILF_RING_READER()
+{
+    if (header != nullptr)
+        munmap(header, mapped);
+}
+
+bool ILF_RING_READER::open(const string &name, string &error)
+{
+    int fd = shm_open(name.c_str(), O_RDWR, 0);
+    if (fd < 0) {
+        error = "Error opening the shared memory ring " + name + ": " + strerror(errno);
+        return false;
+    }
+    struct stat status;
+    void *memory = MAP_FAILED;
+    if (fstat(fd, &status) == 0 && (size_t) status.st_size > header_bytes)
+        memory = mmap(nullptr, status.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED) {
+        error = "Error mapping the shared memory ring " + name;
+        return false;
+    }
+
+    ilf_ring_header *ring = (ilf_ring_header *) memory;
+    bool ready = memcmp(ring->magic, ILF_RING_MAGIC, sizeof(ring->magic)) == 0;
+    atomic_thread_fence(memory_order_acquire);
+    if (!ready || ring->version != ILF_RING_VERSION || ring->record_alignment != ILF_RING_RECORD_ALIGNMENT
+        || header_bytes + ring->capacity != (size_t) status.st_size) {
+        error = "The shared memory ring " + name + (ready ? " has an unknown version or layout" : " isn't ready yet");
+        munmap(memory, status.st_size);
+        return false;
+    }
+
+    if (header != nullptr)
+        munmap(header, mapped);
+    header = ring;
+    data = (char *) memory + header_bytes;
+    mapped = status.st_size;
+    tail = header->tail.load(memory_order_acquire);
+    cached_head = tail;
+    pending = 0;
+    return true;
+}
+
+void ILF_RING_READER::set_spin_us(int us)
+{
+    spin_us = us;
+}
+
+bool ILF_RING_READER::closed() const
+{
+    return header != nullptr && header->closed.load(memory_order_acquire);
+}
+
+uint64_t ILF_RING_READER::get_dropped() const
+{
+    return header == nullptr ? 0 : header->dropped.load(memory_order_relaxed);
+}
+
+bool ILF_RING_READER::try_read(string_view &record)
+{
+    uint64_t capacity = header->capacity;
+    while (true) {
+        // the writer's cache line is only read when everything seen last has been read
+        if (cached_head == tail) {
+            cached_head = header->head.load(memory_order_acquire);
+            if (cached_head == tail)
+                return false;
+        }
+
+        size_t offset = tail & (capacity - 1);
+        uint32_t length;
+        memcpy(&length, data + offset, 4);
+        if (length == ILF_RING_WRAP) {
+            tail += capacity - offset;
+            header->tail.store(tail, memory_order_release);
+            continue;
+        }
+        record = string_view(data + offset + 4, length);
+        pending = ILF_RING_WRITER::record_bytes(length);
+        return true;
+    }
+}
+
+bool ILF_RING_READER::next(string_view &record, int timeout_ms)
+{
+    if (header == nullptr)
+        return false;
+
+    // frees the record returned last, which the caller is done with
+    if (pending > 0) {
+        tail += pending;
+        pending = 0;
+        header->tail.store(tail, memory_order_release);
+    }
+
+    auto start = chrono::steady_clock::now();
+    auto spin_until = start + chrono::microseconds(spin_us);
+    do {
+        if (try_read(record))
+            return true;
+        cpu_relax();
+    } while (timeout_ms != 0 && chrono::steady_clock::now() < spin_until);
+
+    while (true) {
+        if (try_read(record))
+            return true;
+        // every record is written before the ring is closed
+        if (header->closed.load(memory_order_acquire))
+            return try_read(record);
+
+        int left = -1;
+        if (timeout_ms >= 0) {
+            left = timeout_ms - (int) chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start).count();
+            if (left <= 0)
+                return false;
+        }
+        sleep(left);
+    }
+}
+
+// Sleeps until the writer wakes the reader, unless a record came in meanwhile
+void ILF_RING_READER::sleep(int timeout_ms)
+{
+    uint32_t wakeups = header->wakeups.load(memory_order_acquire);
+    header->reader_sleeping.store(1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    if (header->head.load(memory_order_relaxed) == tail && !header->closed.load(memory_order_relaxed))
+        futex_wait(header->wakeups, wakeups, timeout_ms);
+    header->reader_sleeping.store(0, memory_order_relaxed);
+}
+
+#endif
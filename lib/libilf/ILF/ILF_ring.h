@@ -0,0 +1,137 @@
+//  Copyright (c) 2019-2021 The MITRE Corporation. ALL RIGHTS RESERVED.
+//
+//  The Happened-Before Language (HBL) and its detection engine are the
+//  products of The MITRE Corporation, developed with MITRE funds.
+//  This copyright notice must not be removed from this software, absent
+//  MITRE's express written permission.
+
+#ifndef ILF_RING_H
+#define ILF_RING_H
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <string_view>
+
+using namespace std;
+
+/*
+    Single-producer, single-consumer ring of records in POSIX shared memory, through which the
+    translator hands ILF events to a detection engine on the same host without a network hop.
+
+    The shared object starts with an ilf_ring_header, followed by the data area. head and tail
+    count the bytes written and read since the ring was created; each is written by one side only
+    and sits on its own cache line. A record is its length (4 bytes) followed by its bytes, padded
+    to 8 bytes; a record never wraps around the end of the data area, which is skipped instead,
+    marked by ILF_RING_WRAP in place of a length. Records are read in place.
+
+    A reader with nothing to read sleeps on a futex (on Linux; elsewhere it polls), which the
+    writer only wakes when the reader has said it is going to sleep, so a busy ring costs no system
+    calls on either side.
+*/
+
+#define ILF_RING_MAGIC "ILFRING"
+#define ILF_RING_VERSION 1
+#define ILF_RING_CACHE_LINE 64
+#define ILF_RING_WRAP 0xffffffffu
+
+struct ilf_ring_header {
+    char magic[8];                      // ILF_RING_MAGIC once the ring is ready
+    uint32_t version;
+    uint32_t record_alignment;
+    uint64_t capacity;                  // bytes of the data area, a power of two
+
+    // written by the writer
+    alignas(ILF_RING_CACHE_LINE) atomic<uint64_t> head;
+    atomic<uint64_t> dropped;           // records that didn't fit
+    atomic<uint32_t> closed;
+
+    // written by the reader
+    alignas(ILF_RING_CACHE_LINE) atomic<uint64_t> tail;
+
+    // futex word the reader sleeps on, and whether it is asleep
+    alignas(ILF_RING_CACHE_LINE) atomic<uint32_t> wakeups;
+    atomic<uint32_t> reader_sleeping;
+};
+
+class ILF_RING_WRITER {
+    public:
+        ILF_RING_WRITER() {}
+        ILF_RING_WRITER(const ILF_RING_WRITER &) = delete;
+        ILF_RING_WRITER &operator=(const ILF_RING_WRITER &) = delete;
+        ~ILF_RING_WRITER();
+
+        // Creates the ring under name (e.g. "/ilf"), replacing one left behind, with a data area of
+        // at least capacity bytes. Returns false, with the reason in error, if it can't.
+        bool create(const string &name, size_t capacity, string &error);
+
+        // Appends a record and wakes the reader if it sleeps. Returns false, counting the record as
+        // dropped if drop is set, when there isn't room for it. A record that doesn't fit before the
+        // end of the data area goes at its start, once the reader has passed the end; the end is
+        // marked skipped as soon as it is free, so the reader can pass it.
+        bool try_write(string_view record, bool drop);
+
+        // Tells the reader no more records are coming, and removes the name. Readers that have the
+        // ring mapped read what is left.
+        void close();
+
+        uint64_t get_dropped() const;
+
+        // Bytes of the data area, the capacity asked for rounded up to a power of two, or 0
+        // before create()
+        uint64_t get_capacity() const;
+
+        // Bytes a record of size bytes takes in the data area: its length, and its bytes padded
+        static size_t record_bytes(size_t size);
+
+    private:
+        string name;
+        ilf_ring_header *header = nullptr;
+        char *data = nullptr;
+        size_t mapped = 0;
+        uint64_t head = 0;
+        uint64_t cached_tail = 0;       // tail as last read, refreshed when the ring looks full
+
+        bool has_room(size_t bytes);
+        void wake_reader();
+};
+
+class ILF_RING_READER {
+    public:
+        ILF_RING_READER() {}
+        ILF_RING_READER(const ILF_RING_READER &) = delete;
+        ILF_RING_READER &operator=(const ILF_RING_READER &) = delete;
+        ~ILF_RING_READER();
+
+        // Maps the ring created under name. Returns false, with the reason in error, if there is
+        // none yet.
+        bool open(const string &name, string &error);
+
+        // Reads the next record, in place: it stays valid until the next call. Waits up to
+        // timeout_ms for one (-1: until there is one, 0: not at all), spinning for spin_us first.
+        // Returns false on timeout, or once the writer has closed the ring and every record is read.
+        bool next(string_view &record, int timeout_ms = -1);
+
+        // Microseconds spent polling before sleeping, trading a core for latency (default 20)
+        void set_spin_us(int us);
+
+        // Whether the writer has closed the ring
+        bool closed() const;
+
+        // Records the writer dropped because the ring was full
+        uint64_t get_dropped() const;
+
+    private:
+        ilf_ring_header *header = nullptr;
+        char *data = nullptr;
+        size_t mapped = 0;
+        uint64_t tail = 0;
+        uint64_t cached_head = 0;
+        size_t pending = 0;             // bytes of the record returned last, freed by the next call
+        int spin_us = 20;
+
+        bool try_read(string_view &record);
+        void sleep(int timeout_ms);
+};
+
+#endif
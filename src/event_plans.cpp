@@ -0,0 +1,288 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+/*
+    Class definition for the translation plans compiled from the configuration files.
+*/
+#include <algorithm>
+#include <iostream>
+
+#include "event_plans.h"
+
+// Sysmon fields holding several values, and how they are split. Another field is split the same
+// way by adding it here, e.g. { "ParentUser", SPLIT_USER, QUOTE_UNLESS_NUMBER }.
+static const struct {
+    const char *source;
+    field_split split;
+    value_quoting quoting;
+} split_fields[] = {
+    { HASHES, SPLIT_HASHES, QUOTE_ALWAYS },
+    { HASH,   SPLIT_HASHES, QUOTE_ALWAYS },
+    { USER,   SPLIT_USER,   QUOTE_UNLESS_NUMBER },
+};
+
+EVENT_PLANS::EVENT_PLANS()
+{
+    table.resize(EVENT_PLAN_TABLE_SIZE);
+}
+
+// IDs are compared as strings, so "07" is not the same ID as "7" and goes to the map.
+int EVENT_PLANS::table_index(string_view id)
+{
+    if (id.empty() || id.size() > 3 || (id[0] == '0' && id.size() > 1))
+        return -1;
+
+    int index = 0;
+    for (char c : id) {
+        if (c < '0' || c > '9')
+            return -1;
+        index = index * 10 + (c - '0');
+    }
+    return index < EVENT_PLAN_TABLE_SIZE ? index : -1;
+}
+
+const event_plan &EVENT_PLANS::find(string_view id) const
+{
+    int index = table_index(id);
+    if (index >= 0)
+        return table[index];
+
+    auto it = other_plans.find(id);
+    return it == other_plans.end() ? unconfigured : it->second;
+}
+
+event_plan &EVENT_PLANS::add(const string &id)
+{
+    int index = table_index(id);
+    event_plan &plan = index >= 0 ? table[index] : other_plans[id];
+    plan.id = id;
+    return plan;
+}
+
+void EVENT_PLANS::deny(const set<string, less<>> &ids)
+{
+    for (const string &id : ids)
+        add(id).disposition = EVENT_DENIED;
+}
+
+void EVENT_PLANS::clear()
+{
+    table.assign(EVENT_PLAN_TABLE_SIZE, event_plan());
+    other_plans.clear();
+    slots = FIELD_SLOTS();
+}
+
+// Compiles a plan for each event ID with a name: its allowed fields that have a mapping, in order,
+// with their ILF keys. Fields that could never be emitted (no mapping, or a 1:many mapping on a
+// field that can't be split) are left out. Returns false, leaving the plans cleared, if a
+// configuration has the wrong types.
+bool EVENT_PLANS::compile(const json &event_names, const json &allowed_fields, const json &field_mappings,
+                          const set<string, less<>> &denied_ids)
+{
+    clear();
+
+    try {
+        for (auto &e : event_names.items()) {
+            event_plan &plan = add(e.key());
+            plan.event_name = e.value().get<string>();
+            plan.disposition = denied_ids.count(e.key()) ? EVENT_DENIED : EVENT_TRANSLATED;
+
+            if (!allowed_fields.contains(e.key())) {
+                cerr << "No allowed fields configured for event #: " << e.key() << ". Its events are translated without fields." << endl;
+                continue;
+            }
+
+            json mappings = field_mappings.contains(e.key()) ? field_mappings.at(e.key()) : json::object();
+            for (auto &allowed_field : allowed_fields.at(e.key())) {
+                string source = allowed_field.get<string>();
+                if (!mappings.is_object() || !mappings.contains(source))
+                    continue;
+
+                const json &ecs_field_object = mappings.at(source);
+                field_plan field = { source, -1, SPLIT_NONE, QUOTE_UNLESS_NUMBER, "", {} };
+
+                // Case 1: ECS field is a string
+                if (ecs_field_object.is_string()) {
+                    field.key = ilf_key(ecs_field_object.get<string>());
+
+                // Case 2: ECS field is an array of strings (1:many mapping) for the Sysmon fields in split_fields
+                } else if (ecs_field_object.is_array()) {
+                    for (auto &split_field : split_fields) {
+                        if (source == split_field.source) {
+                            field.split = split_field.split;
+                            field.quoting = split_field.quoting;
+                        }
+                    }
+                    if (field.split == SPLIT_NONE)
+                        continue;
+
+                    bool all_strings = true;
+                    for (auto &ecs_field_name : ecs_field_object) {
+                        all_strings = all_strings && ecs_field_name.is_string();
+                        if (all_strings)
+                            add_subfield(field, ecs_field_name.get<string>());
+                    }
+                    if (!all_strings)
+                        continue;
+
+                    sort(field.subfields.begin(), field.subfields.end(),
+                         [](const subfield_plan &a, const subfield_plan &b) { return a.name < b.name; });
+                    assign_parts(field);
+                } else {
+                    continue;
+                }
+
+                plan.fields.push_back(field);
+            }
+        }
+    } catch (const json::exception &e) {
+        cerr << "Exception in compile_event_plans(): " << e.what() << endl;
+        clear();
+        return false;
+    }
+
+    // denied IDs without an event name are still counted as denied
+    for (const string &id : denied_ids) {
+        event_plan &plan = add(id);
+        if (plan.disposition == EVENT_UNCONFIGURED)
+            plan.disposition = EVENT_DENIED;
+    }
+
+    // Data fields that no plan uses are skipped during extraction
+    assign_slots();
+    return true;
+}
+
+// adds one attribute of a 1:many mapping to the field's plan, named after the last part of
+// the ECS field. e.g "md5" for "file.hash.md5", "name" for "user.name".
+// the first ECS field with a given name wins.
+void EVENT_PLANS::add_subfield(field_plan &field, const string &ecs_field_name)
+{
+    string name = ecs_field_name.substr(ecs_field_name.rfind('.') + 1);
+    for (const subfield_plan &subfield : field.subfields) {
+        if (subfield.name == name)
+            return;
+    }
+    field.subfields.push_back({ name, ilf_key(ecs_field_name), -1 });
+}
+
+// Each hash type is its own part. A user has the domain and the name, which only go to the
+// "domain" and "name" subfields, and to neither if "name" isn't configured.
+void EVENT_PLANS::assign_parts(field_plan &field)
+{
+    bool has_name = any_of(field.subfields.begin(), field.subfields.end(),
+                           [](const subfield_plan &s) { return s.name == "name"; });
+
+    for (size_t i = 0; i < field.subfields.size(); i++) {
+        subfield_plan &subfield = field.subfields[i];
+        subfield.part = -1;
+
+        if (field.split == SPLIT_HASHES && i < FIELD_SPLIT_MAX_PARTS)
+            subfield.part = i;
+        else if (field.split == SPLIT_USER && has_name && subfield.name == "domain")
+            subfield.part = USER_DOMAIN;
+        else if (field.split == SPLIT_USER && has_name && subfield.name == "name")
+            subfield.part = USER_NAME;
+    }
+}
+
+// replaces the periods in an ECS field with two underscores, e.g. "process.pid" -> "process__pid"
+string EVENT_PLANS::ilf_key(const string &ecs_field_name)
+{
+    string key;
+    for (char c : ecs_field_name) {
+        if (c == '.')
+            key += "__";
+        else
+            key += c;
+    }
+    return key;
+}
+
+bool EVENT_PLANS::load_generated(const generated_event *events, size_t event_count,
+                                 const string_view *slot_names, size_t slot_count)
+{
+    clear();
+
+    for (size_t i = 0; i < event_count; i++) {
+        event_plan &plan = add(string(events[i].id));
+        plan.event_name = events[i].event_name;
+        plan.disposition = EVENT_TRANSLATED;
+        for (size_t f = 0; f < events[i].source_count; f++)
+            plan.fields.push_back({ string(events[i].sources[f]), -1, SPLIT_NONE, QUOTE_UNLESS_NUMBER, "", {} });
+    }
+
+    // the slots only depend on the plans, so they match the generated ones unless the plans do not
+    assign_slots();
+
+    if (slots.size() != slot_count)
+        return false;
+    for (size_t slot = 0; slot < slot_count; slot++) {
+        if (slots.get_name(slot) != slot_names[slot])
+            return false;
+    }
+    return true;
+}
+
+template <typename F>
+void EVENT_PLANS::for_each_plan(F f)
+{
+    for (event_plan &plan : table)
+        f(plan);
+    for (auto &e : other_plans)
+        f(e.second);
+}
+
+void EVENT_PLANS::assign_slots()
+{
+    vector<string> names;
+    for_each_plan([&names](event_plan &plan) {
+        if (plan.disposition != EVENT_TRANSLATED)
+            return;
+        for (const field_plan &field : plan.fields)
+            names.push_back(field.source);
+    });
+
+    slots.build(names);
+
+    for_each_plan([this](event_plan &plan) {
+        plan.used_slots.assign(plan.disposition == EVENT_TRANSLATED ? slots.size() : 0, false);
+        for (field_plan &field : plan.fields) {
+            field.slot = slots.find(field.source);
+            if (field.slot >= 0 && plan.disposition == EVENT_TRANSLATED)
+                plan.used_slots[field.slot] = true;
+        }
+    });
+}
+
+int EVENT_PLANS::find_slot(const event_plan &plan, string_view name) const
+{
+    int slot = slots.find(name);
+    return slot >= 0 && (size_t) slot < plan.used_slots.size() && plan.used_slots[slot] ? slot : -1;
+}
+
+size_t EVENT_PLANS::get_slot_count() const
+{
+    return slots.size();
+}
+
+const string &EVENT_PLANS::get_slot_name(int slot) const
+{
+    return slots.get_name(slot);
+}
+
+vector<const event_plan *> EVENT_PLANS::get_plans() const
+{
+    vector<const event_plan *> plans;
+    for (const event_plan &plan : table) {
+        if (plan.disposition != EVENT_UNCONFIGURED)
+            plans.push_back(&plan);
+    }
+    for (auto &e : other_plans)
+        plans.push_back(&e.second);
+    return plans;
+}
@@ -0,0 +1,154 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+/*
+    Header file for the translation plans compiled from the configuration files: for each event ID,
+    the event name and the ordered list of fields to emit with their ready-to-use ILF keys.
+*/
+
+#ifndef EVENT_PLANS_H
+#define EVENT_PLANS_H
+
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../lib/json/single_include/nlohmann/json.hpp"
+#include "field_slots.h"
+
+using namespace std;
+using json = nlohmann::json;
+
+#define HASHES "Hashes"
+#define HASH "Hash"
+#define USER "User"
+
+// Event IDs below this value are looked up by index. Sysmon's IDs all fit.
+#define EVENT_PLAN_TABLE_SIZE 256
+
+// Most parts the value of a split field is split into, i.e. hash types of a Hashes field.
+// Configured hash types beyond it are left out.
+#define FIELD_SPLIT_MAX_PARTS 16
+
+// How the value of a Sysmon field is turned into ILF attributes
+enum field_split {
+    SPLIT_NONE,     // one attribute holding the value
+    SPLIT_HASHES,   // "type=hash,type=hash" pairs, one attribute per configured hash type
+    SPLIT_USER      // "domain\name", one attribute each for the configured parts
+};
+
+// How an attribute value is quoted
+enum value_quoting {
+    QUOTE_UNLESS_NUMBER,    // numbers (decimal or 0x-prefixed hex) are left bare
+    QUOTE_ALWAYS,           // hashes, which can look like numbers
+    QUOTE_NEVER             // values written as they are, e.g. the event code
+};
+
+// Parts of a "domain\name" value
+enum user_part { USER_DOMAIN, USER_NAME };
+
+// One attribute of a 1:many mapping, e.g. name "md5" and key "file__hash__md5"
+struct subfield_plan {
+    string name;
+    string key;
+    int part;       // part of the split value the attribute holds, or -1 for none; set by assign_parts()
+};
+
+struct field_plan {
+    string source;                      // Sysmon field, i.e. the Data element's Name
+    int slot;                           // slot of the source field, set by assign_slots()
+    field_split split;
+    value_quoting quoting;
+    string key;                         // ILF key of a SPLIT_NONE field, periods already replaced
+    vector<subfield_plan> subfields;    // attributes of a split field, sorted by name
+};
+
+// What happens to events with a given ID
+enum event_disposition { EVENT_UNCONFIGURED, EVENT_DENIED, EVENT_TRANSLATED };
+
+struct event_plan {
+    event_disposition disposition = EVENT_UNCONFIGURED;
+    string id;
+    string event_name;
+    vector<field_plan> fields;          // in the order of the allowed fields configuration
+    vector<bool> used_slots;            // the slots of the source fields, set by assign_slots()
+};
+
+// An event of the translators generated from the configuration files (see codegen/): its event
+// name and the source fields of its plan, in order
+struct generated_event {
+    string_view id;
+    string_view event_name;
+    const string_view *sources;
+    size_t source_count;
+};
+
+/*
+    Plans for all the configured event IDs. Events are matched to their plan through a dense table
+    indexed by the integer value of the ID; IDs that aren't small integers fall back to a map.
+*/
+class EVENT_PLANS {
+    public:
+        EVENT_PLANS();
+
+        // Compiles the event names, allowed fields and field mappings configurations into a plan for
+        // each named event ID. IDs on the deny list are denied whether they have a name or not.
+        // Returns false if a configuration has the wrong types.
+        bool compile(const json &event_names, const json &allowed_fields, const json &field_mappings,
+                     const set<string, less<>> &denied_ids);
+
+        // Rebuilds the plans the generated translators were compiled from. Only the event names and
+        // the source fields are known, which is all extraction needs. Returns false if the slots
+        // don't come out as the generated code expects them.
+        bool load_generated(const generated_event *events, size_t event_count,
+                            const string_view *slot_names, size_t slot_count);
+
+        // Returns the plan for the given ID. IDs that aren't configured get an EVENT_UNCONFIGURED plan.
+        const event_plan &find(string_view id) const;
+
+        // Returns the plan for the given ID, creating an unconfigured one if there is none
+        event_plan &add(const string &id);
+
+        // Denies the IDs, whether they have a name or not, once the plans are complete
+        void deny(const set<string, less<>> &ids);
+
+        void clear();
+
+        // Gives each subfield of a split field the part of the value it holds, so the value is
+        // split once and each attribute picks its part. Called once the subfields are sorted.
+        static void assign_parts(field_plan &field);
+
+        // Gives every field used by a translated event a slot, and records in each plan the slots
+        // it uses. Called once all the plans are complete.
+        void assign_slots();
+
+        // Returns the slot of a Data field if the plan uses it, or -1
+        int find_slot(const event_plan &plan, string_view name) const;
+        size_t get_slot_count() const;
+        const string &get_slot_name(int slot) const;
+
+        // Returns the plans of the configured event IDs, in the order slots are assigned
+        vector<const event_plan *> get_plans() const;
+
+        // Returns the table index of an ID written as a plain decimal number below
+        // EVENT_PLAN_TABLE_SIZE, or -1
+        static int table_index(string_view id);
+
+    private:
+        vector<event_plan> table;
+        map<string, event_plan, less<>> other_plans;
+        event_plan unconfigured;
+        FIELD_SLOTS slots;
+
+        template <typename F> void for_each_plan(F f);
+        static void add_subfield(field_plan &field, const string &ecs_field_name);
+        static string ilf_key(const string &ecs_field_name);
+};
+
+#endif
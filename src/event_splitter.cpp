@@ -0,0 +1,122 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+/*
+    Class definition for the chunked reader that splits a stream of Sysmon XML into individual events.
+*/
+#include <iostream>
+#include <string.h>
+#include <algorithm>
+
+#include "event_splitter.h"
+#include "scan_kernels.h"
+
+// an opening tag name is terminated by whitespace, '>' or '/'
+static bool is_tag_name_end(char c)
+{
+    return c == ' ' || c == '>' || c == '/' || c == '\n' || c == '\r' || c == '\t';
+}
+
+const char *find_event_open(const char *begin, const char *end)
+{
+    const char *p = begin;
+    while (end - p > (ptrdiff_t) EVENT_OPEN_TAG_LEN) {
+        // stop one byte short so the character after the tag name can be checked
+        p = find_substring(p, end - 1, EVENT_OPEN_TAG, EVENT_OPEN_TAG_LEN);
+        if (p == end - 1)
+            return end;
+
+        if (is_tag_name_end(p[EVENT_OPEN_TAG_LEN]))
+            return p;
+        p++;
+    }
+    return end;
+}
+
+const char *find_event_close(const char *begin, const char *end)
+{
+    return find_substring(begin, end, EVENT_CLOSE_TAG, EVENT_CLOSE_TAG_LEN);
+}
+
+EVENT_SPLITTER::EVENT_SPLITTER(istream &_stream, size_t _chunk_size /* = DEFAULT_CHUNK_SIZE */)
+    : stream(_stream), chunk_size(_chunk_size), buffer(_chunk_size), head(0), tail(0), at_eof(false)
+{
+}
+
+bool EVENT_SPLITTER::next_event(char *&event, size_t &length)
+{
+    // offset from head at which to resume looking for the closing tag after a refill
+    size_t close_scan = 0;
+
+    while (true) {
+        const char *base = buffer.data();
+
+        if (close_scan == 0) {
+            const char *open = find_event_open(base + head, base + tail);
+
+            if (open == base + tail) {
+                // no event starts in the buffered data; keep only what could be the start of a split tag
+                head = tail - min(tail - head, EVENT_OPEN_TAG_LEN);
+                if (!fill())
+                    return false;
+                continue;
+            }
+            head = open - base;
+            close_scan = EVENT_OPEN_TAG_LEN;
+        }
+
+        const char *close = find_event_close(base + head + close_scan, base + tail);
+        if (close != base + tail) {
+            event  = buffer.data() + head;
+            length = (close - base) + EVENT_CLOSE_TAG_LEN - head;
+            head  += length;
+            return true;
+        }
+
+        // the event continues past the buffered data; the closing tag may straddle the refill
+        close_scan = max(close_scan, tail - head - min(tail - head, EVENT_CLOSE_TAG_LEN - 1));
+        if (!fill()) {
+            if (tail > head)
+                cerr << "Discarding incomplete event at the end of the stream" << endl;
+            return false;
+        }
+    }
+}
+
+// pulls the next block from the stream into the buffer, making room for it first.
+// returns false once the stream has no more data.
+bool EVENT_SPLITTER::fill()
+{
+    if (at_eof)
+        return false;
+
+    if (buffer.size() - tail < chunk_size / 2) {
+        compact();
+        if (buffer.size() - tail < chunk_size / 2)
+            buffer.resize(buffer.size() * 2);
+    }
+
+    stream.read(buffer.data() + tail, buffer.size() - tail);
+    size_t bytes_read = stream.gcount();
+    if (bytes_read == 0) {
+        at_eof = true;
+        return false;
+    }
+    tail += bytes_read;
+    return true;
+}
+
+// moves the unconsumed bytes to the front of the buffer
+void EVENT_SPLITTER::compact()
+{
+    if (head == 0)
+        return;
+
+    memmove(buffer.data(), buffer.data() + head, tail - head);
+    tail -= head;
+    head = 0;
+}
@@ -0,0 +1,58 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+/*
+    Header file for the chunked reader that splits a stream of Sysmon XML into individual events.
+*/
+
+#ifndef EVENT_SPLITTER_H
+#define EVENT_SPLITTER_H
+
+#include <istream>
+#include <vector>
+#include <stddef.h>
+
+using namespace std;
+
+// Size of the blocks pulled from the stream. The buffer grows past this if a single event is larger.
+#define DEFAULT_CHUNK_SIZE (1 << 20)
+
+#define EVENT_OPEN_TAG "<Event"
+#define EVENT_CLOSE_TAG "</Event>"
+#define EVENT_OPEN_TAG_LEN (sizeof(EVENT_OPEN_TAG) - 1)
+#define EVENT_CLOSE_TAG_LEN (sizeof(EVENT_CLOSE_TAG) - 1)
+
+// Returns a pointer to the '<' of the first "<Event" opening tag in [begin, end), or end if there is
+// none. Tags that merely start with "Event" (Events, EventData, EventID, ...) are not matched.
+const char *find_event_open(const char *begin, const char *end);
+
+// Returns a pointer to the '<' of the first "</Event>" closing tag in [begin, end), or end if there is none.
+const char *find_event_close(const char *begin, const char *end);
+
+class EVENT_SPLITTER {
+    public:
+        EVENT_SPLITTER(istream &stream, size_t chunk_size = DEFAULT_CHUNK_SIZE);
+
+        // Finds the next complete <Event>...</Event> element in the stream, regardless of how it
+        // is split across lines. The returned slice points into the internal buffer, may be modified
+        // in place by the caller, and stays valid until the next call. Returns false at end of stream.
+        bool next_event(char *&event, size_t &length);
+
+    private:
+        istream &stream;
+        size_t chunk_size;
+
+        // Buffered bytes live in [head, tail) of the buffer
+        vector<char> buffer;
+        size_t head, tail;
+        bool at_eof;
+
+        bool fill();
+        void compact();
+};
+
+#endif
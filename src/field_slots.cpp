@@ -0,0 +1,87 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+/*
+    Class definition for the perfect hash mapping the known Sysmon field names to slots.
+*/
+#include <algorithm>
+
+#include "field_slots.h"
+
+// seeds tried for a table size before it is doubled
+#define FIELD_SLOTS_SEED_ATTEMPTS 256
+
+FIELD_SLOTS::FIELD_SLOTS()
+{
+    buckets.assign(1, -1);
+    seed = 0;
+    mask = 0;
+}
+
+// FNV-1a, with the seed mixed into the offset basis
+uint32_t FIELD_SLOTS::hash(string_view name, uint32_t seed)
+{
+    uint32_t h = 2166136261u ^ (seed * 0x9E3779B9u);
+    for (char c : name) {
+        h ^= (unsigned char) c;
+        h *= 16777619u;
+    }
+    return h ^ (h >> 15);
+}
+
+// fills the buckets using the given seed, and returns false on the first collision
+bool FIELD_SLOTS::try_seed(uint32_t seed, uint32_t bucket_count)
+{
+    buckets.assign(bucket_count, -1);
+    for (size_t slot = 0; slot < names.size(); slot++) {
+        int &bucket = buckets[hash(names[slot], seed) & (bucket_count - 1)];
+        if (bucket != -1)
+            return false;
+        bucket = (int) slot;
+    }
+    this->seed = seed;
+    mask = bucket_count - 1;
+    return true;
+}
+
+void FIELD_SLOTS::build(const vector<string> &all_names)
+{
+    names.clear();
+    for (const string &name : all_names) {
+        if (::find(names.begin(), names.end(), name) == names.end())
+            names.push_back(name);
+    }
+
+    // start at a load factor of at most one half
+    uint32_t bucket_count = 1;
+    while (bucket_count < 2 * names.size())
+        bucket_count *= 2;
+
+    while (true) {
+        for (uint32_t s = 0; s < FIELD_SLOTS_SEED_ATTEMPTS; s++) {
+            if (try_seed(s, bucket_count))
+                return;
+        }
+        bucket_count *= 2;
+    }
+}
+
+int FIELD_SLOTS::find(string_view name) const
+{
+    int slot = buckets[hash(name, seed) & mask];
+    return slot != -1 && names[slot] == name ? slot : -1;
+}
+
+size_t FIELD_SLOTS::size() const
+{
+    return names.size();
+}
+
+const string &FIELD_SLOTS::get_name(int slot) const
+{
+    return names[slot];
+}
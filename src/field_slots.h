@@ -0,0 +1,50 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+/*
+    Header file for the perfect hash mapping the known Sysmon field names to slots.
+*/
+
+#ifndef FIELD_SLOTS_H
+#define FIELD_SLOTS_H
+
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+
+/*
+    Gives each known field name (the Name of a Data element) a small integer slot, so values can be
+    stored in an array instead of a map. The hash seed and table size are searched at build time
+    until no two names share a bucket, so a lookup is one hash, one bucket and one compare.
+*/
+class FIELD_SLOTS {
+    public:
+        FIELD_SLOTS();
+
+        // Assigns slots 0, 1, ... to the distinct names, in order of first appearance
+        void build(const vector<string> &names);
+
+        // Returns the slot of the name, or -1 if it isn't a known name
+        int find(string_view name) const;
+
+        size_t size() const;
+        const string &get_name(int slot) const;
+
+    private:
+        vector<string> names;
+        vector<int> buckets;    // slot of the name hashed to each bucket, or -1
+        uint32_t seed;
+        uint32_t mask;
+
+        static uint32_t hash(string_view name, uint32_t seed);
+        bool try_seed(uint32_t seed, uint32_t bucket_count);
+};
+
+#endif
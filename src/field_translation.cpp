@@ -0,0 +1,155 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+/*
+    Functions turning the Data fields extracted from an event into ILF attributes.
+*/
+#include <algorithm>
+
+#include "field_translation.h"
+
+static bool equals_lowercase(string_view s, string_view lowercase);
+static void add_user(const field_plan &field, string_view value, vector<ilf_attribute> &attributes);
+static void add_hashes(const field_plan &field, string_view value, vector<ilf_attribute> &attributes);
+
+// loops through the fields in the event's plan, finds their values in the extracted event data,
+// and appends them to the attributes.
+void translate_fields(const event_plan &plan, const sysmon_fields &fields, vector<ilf_attribute> &attributes)
+{
+    for (const field_plan &field : plan.fields) {
+        string_view value;
+        if (!find_value(fields, field.slot, field.source, value))
+            continue;
+
+        switch (field.split) {
+            case SPLIT_NONE:
+                add_value(attributes, field.key, value, field.quoting);
+                break;
+            case SPLIT_HASHES:
+                add_hashes(field, value, attributes);
+                break;
+            case SPLIT_USER:
+                add_user(field, value, attributes);
+                break;
+        }
+    }
+}
+
+bool find_value(const sysmon_fields &fields, int slot, string_view source, string_view &value)
+{
+    if (fields.projected) {
+        if (!fields.has_value(slot))
+            return false;
+        value = fields.values[slot];
+        return true;
+    }
+
+    // the first Data element with the name holds the value
+    auto data = find_if(fields.data.begin(), fields.data.end(),
+                        [source](const pair<string_view, string_view> &d) { return d.first == source; });
+    if (data == fields.data.end())
+        return false;
+    value = data->second;
+    return true;
+}
+
+// the key and value are views, so nothing is copied until the event is rendered
+void add_value(vector<ilf_attribute> &attributes, string_view key, string_view value, value_quoting quoting)
+{
+    attributes.push_back({ key, value, quoting });
+}
+
+// the domain is everything before the first '\', the name the rest of the first line after it
+bool split_user(string_view value, string_view &domain, string_view &name)
+{
+    size_t separator = value.find('\\');
+    domain = value.substr(0, separator);
+
+    // no value present for this field in XML event
+    if (domain == "-")
+        return false;
+
+    name = string_view();
+    if (separator != string_view::npos) {
+        name = value.substr(separator + 1);
+        name = name.substr(0, name.find('\n'));
+    }
+    return true;
+}
+
+// an element without a '=' is a type with an empty hash, and a hash ends at the end of its line
+void split_hashes(string_view value, const string_view *types, size_t type_count, string_view *hashes)
+{
+    for (size_t i = 0; i < type_count; i++)
+        hashes[i] = string_view();
+
+    size_t start = 0;
+    while (start < value.size()) {
+        size_t comma = min(value.find(',', start), value.size());
+        string_view element = value.substr(start, comma - start);
+        start = comma + 1;
+
+        size_t equals = element.find('=');
+        string_view type = element.substr(0, equals);
+        for (size_t i = 0; i < type_count; i++) {
+            if (!equals_lowercase(type, types[i]))
+                continue;
+            string_view hash = equals == string_view::npos ? string_view() : element.substr(equals + 1);
+            hashes[i] = hash.substr(0, hash.find('\n'));
+        }
+    }
+}
+
+bool find_hash(string_view value, string_view type, string_view &hash)
+{
+    split_hashes(value, &type, 1, &hash);
+    return !hash.empty();
+}
+
+// compares a hash type from an event, lowercased, with a configured subfield name
+static bool equals_lowercase(string_view s, string_view lowercase)
+{
+    if (s.size() != lowercase.size())
+        return false;
+
+    for (size_t i = 0; i < s.size(); i++) {
+        char c = (s[i] >= 'A' && s[i] <= 'Z') ? s[i] - 'A' + 'a' : s[i];
+        if (c != lowercase[i])
+            return false;
+    }
+    return true;
+}
+
+// adds an attribute for each of the User field's subfields, holding the part of the value it was
+// assigned. subfields without a part get an empty value.
+static void add_user(const field_plan &field, string_view value, vector<ilf_attribute> &attributes)
+{
+    string_view parts[2];
+    if (!split_user(value, parts[USER_DOMAIN], parts[USER_NAME]))
+        return;
+
+    for (const subfield_plan &subfield : field.subfields)
+        add_value(attributes, subfield.key, subfield.part >= 0 ? parts[subfield.part] : string_view(), field.quoting);
+}
+
+// adds the hashes whose type is one of the field's subfields, splitting the value once for all of
+// them. subfields without a hash in the event are left out.
+static void add_hashes(const field_plan &field, string_view value, vector<ilf_attribute> &attributes)
+{
+    // the subfields' parts are their positions, so their names are the types in order
+    string_view types[FIELD_SPLIT_MAX_PARTS], hashes[FIELD_SPLIT_MAX_PARTS];
+    size_t type_count = min(field.subfields.size(), (size_t) FIELD_SPLIT_MAX_PARTS);
+    for (size_t i = 0; i < type_count; i++)
+        types[i] = field.subfields[i].name;
+
+    split_hashes(value, types, type_count, hashes);
+
+    for (const subfield_plan &subfield : field.subfields) {
+        if (subfield.part >= 0 && !hashes[subfield.part].empty())
+            add_value(attributes, subfield.key, hashes[subfield.part], field.quoting);
+    }
+}
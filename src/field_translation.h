@@ -0,0 +1,47 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+/*
+    Header file for turning the Data fields extracted from an event into ILF attributes, either by
+    following the event's plan or from the translators generated from the configuration files.
+*/
+
+#ifndef FIELD_TRANSLATION_H
+#define FIELD_TRANSLATION_H
+
+#include <string_view>
+#include <vector>
+
+#include "event_plans.h"
+#include "ilf_view.h"
+#include "sysmon_scanner.h"
+
+using namespace std;
+
+// Appends an attribute for each field in the event's plan that has a value in the event
+void translate_fields(const event_plan &plan, const sysmon_fields &fields, vector<ilf_attribute> &attributes);
+
+// Finds the value of a Data field, by slot if the event was projected or else by name.
+// Returns false if the event doesn't have the field.
+bool find_value(const sysmon_fields &fields, int slot, string_view source, string_view &value);
+
+// Appends an attribute. Its value is quoted when the event is rendered, unless it is a number
+// (decimal or 0x-prefixed hex) and the quoting is QUOTE_UNLESS_NUMBER.
+void add_value(vector<ilf_attribute> &attributes, string_view key, string_view value, value_quoting quoting);
+
+// Splits a "domain\name" value. Returns false if the value is "-", i.e. there is no user.
+bool split_user(string_view value, string_view &domain, string_view &name);
+
+// Splits a "type=hash,type=hash" value in one pass, setting hashes[i] to the hash of types[i]
+// (lowercase). The last hash of a type wins, and types without one get an empty hash.
+void split_hashes(string_view value, const string_view *types, size_t type_count, string_view *hashes);
+
+// Finds the hash of the given (lowercase) type in a "type=hash,type=hash" value. The last hash of
+// a type wins. Returns false if the value has no hash of the type, or it is empty.
+bool find_hash(string_view value, string_view type, string_view &hash);
+
+#endif
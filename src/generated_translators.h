@@ -0,0 +1,39 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+/*
+    Header file for the translators generated from the configuration files by
+    codegen/generate_translators. Only available in builds with GENERATED_TRANSLATORS defined.
+*/
+
+#ifndef GENERATED_TRANSLATORS_H
+#define GENERATED_TRANSLATORS_H
+
+#include <stddef.h>
+#include <string_view>
+#include <vector>
+
+#include "event_plans.h"
+#include "field_translation.h"
+#include "ilf_view.h"
+#include "sysmon_scanner.h"
+
+using namespace std;
+
+// The events with a generated translator, with the source fields of each
+extern const generated_event generated_events[];
+extern const size_t generated_event_count;
+
+// The field slots the generated translators read, as EVENT_PLANS::load_generated() must assign them
+extern const string_view generated_slot_names[];
+extern const size_t generated_slot_count;
+
+// Appends the attributes of the event's Data fields with the translator of its ID.
+// Returns false if the ID has no translator.
+bool translate_generated(string_view id, const sysmon_fields &fields, vector<ilf_attribute> &attributes);
+
+#endif
@@ -0,0 +1,78 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+/*
+    Class definition for the non-owning view of a translated event.
+*/
+#include "ilf_view.h"
+
+void ILF_VIEW::clear()
+{
+    event_type = sender = receiver = time = string_view();
+    attributes.clear();
+}
+
+// eventType[sender,receiver,time,(key=value;key=value)] with a trailing space
+void ILF_VIEW::append_to(string &out) const
+{
+    // quoting adds two bytes to most values, and escapes are rare
+    size_t size = event_type.size() + sender.size() + receiver.size() + time.size() + 8;
+    for (const ilf_attribute &attribute : attributes)
+        size += attribute.key.size() + attribute.value.size() + 4;
+    out.reserve(out.size() + size);
+
+    out += event_type;
+    out += '[';
+    out += sender;
+    out += ',';
+    out += receiver;
+    out += ',';
+    out += time;
+    out += ",(";
+    for (size_t i = 0; i < attributes.size(); i++) {
+        if (i > 0)
+            out += ';';
+        out += attributes[i].key;
+        out += '=';
+        append_value(out, attributes[i].value, attributes[i].quoting);
+    }
+    out += ")] ";
+}
+
+// Values left bare by their quoting are sent as they are, the others before they are quoted
+void ILF_VIEW::encode(ILF_ENCODER &encoder, string &out) const
+{
+    encoder.start_event(event_type, sender, receiver, time);
+    for (const ilf_attribute &attribute : attributes) {
+        if (attribute.quoting == QUOTE_NEVER || (attribute.quoting == QUOTE_UNLESS_NUMBER && is_number(attribute.value)))
+            encoder.add_bare(attribute.key, attribute.value);
+        else
+            encoder.add_quoted(attribute.key, attribute.value);
+    }
+    encoder.end_event(out);
+}
+
+ILF ILF_VIEW::to_ilf() const
+{
+    return to_ilf(allocator<char>());
+}
+
+// determines if a value represents a number (as decimal or hex) or not.
+// "0x" followed by anything counts as hex, and the empty string as a number.
+bool is_number(string_view value)
+{
+    // hex
+    if (value.size() >= 2 && value[0] == '0' && value[1] == 'x')
+        return true;
+
+    // decimal
+    for (char c : value) {
+        if ((c < '0' || c > '9') && c != '.')
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,107 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+/*
+    Header file for the non-owning view of a translated event, which is rendered to ILF text
+    straight from the strings it points to.
+*/
+
+#ifndef ILF_VIEW_H
+#define ILF_VIEW_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "../lib/libilf/ILF/ILF.h"
+#include "../lib/libilf/ILF/ILF_binary.h"
+#include "event_plans.h"
+
+using namespace std;
+
+// An attribute of a translated event. The value is quoted when the event is rendered.
+struct ilf_attribute {
+    string_view key;
+    string_view value;
+    value_quoting quoting;
+};
+
+/*
+    A translated event that owns none of its strings: the event type and the keys point into the
+    plans (or the generated translators), and the sender, time and values into the event's bytes or
+    XML tree. It is only valid until the next event is extracted. Callers that keep events convert
+    it to an ILF, which copies the strings, with the allocator they give (e.g. a pmr_ILF allocated
+    from a buffer released once a batch of events is done).
+*/
+class ILF_VIEW {
+    public:
+        string_view event_type;
+        string_view sender;
+        string_view receiver;
+        string_view time;
+        vector<ilf_attribute> attributes;
+
+        // Empties the view, keeping the capacity of the attributes for the next event
+        void clear();
+
+        // Appends the same text as the to_string() of the ILF the view converts to
+        void append_to(string &out) const;
+
+        // Appends the event in the binary encoding, which decodes to the same text
+        void encode(ILF_ENCODER &encoder, string &out) const;
+
+        ILF to_ilf() const;
+
+        template <class Allocator>
+        basic_ILF<Allocator> to_ilf(const Allocator &allocator) const;
+};
+
+// determines if a value represents a number (as decimal or hex) or not
+bool is_number(string_view value);
+
+// Appends a value, quoted and escaped like std::quoted does unless its quoting leaves it bare
+template <class String>
+void append_value(String &out, string_view value, value_quoting quoting)
+{
+    if (quoting == QUOTE_NEVER || (quoting == QUOTE_UNLESS_NUMBER && is_number(value))) {
+        out += value;
+        return;
+    }
+
+    // the characters between two escapes are appended at once
+    out += '"';
+    const char *run = value.data(), *end = run + value.size();
+    for (const char *p = run; p < end; p++) {
+        if (*p == '"' || *p == '\\') {
+            out.append(run, p);
+            out += '\\';
+            run = p;
+        }
+    }
+    out.append(run, end);
+    out += '"';
+}
+
+// Every string of the ILF, and its pairs, come from the allocator
+template <class Allocator>
+basic_ILF<Allocator> ILF_VIEW::to_ilf(const Allocator &allocator) const
+{
+    typedef typename basic_ILF<Allocator>::string_type string_type;
+
+    typename basic_ILF<Allocator>::key_vals_type pairs(allocator);
+    pairs.reserve(attributes.size());
+    for (const ilf_attribute &attribute : attributes) {
+        string_type value(allocator);
+        value.reserve(attribute.value.size() + 2);
+        append_value(value, attribute.value, attribute.quoting);
+        pairs.emplace_back(string_type(attribute.key, allocator), move(value));
+    }
+    return basic_ILF<Allocator>(string_type(event_type, allocator), string_type(sender, allocator),
+                                string_type(receiver, allocator), string_type(time, allocator), move(pairs));
+}
+
+#endif
@@ -0,0 +1,197 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+/*
+    Class definition for the writer gathering ILF lines into batches.
+*/
+#include <errno.h>
+#include <iostream>
+#include <string.h>
+
+#ifndef _WIN32
+#include <sys/uio.h>
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
+
+#include "line_writer.h"
+
+LINE_WRITER::LINE_WRITER(metric &writes): writes(writes)
+{
+    fd = -1;
+    batch_lines = LINE_WRITER_BATCH_LINES;
+    linger = chrono::milliseconds(LINE_WRITER_LINGER_MS);
+    stopping = false;
+    flushing = false;
+    current_lines = 0;
+    in_flight = 0;
+}
+
+LINE_WRITER::~LINE_WRITER()
+{
+    stop();
+}
+
+void LINE_WRITER::start(int output_fd, size_t lines, int linger_ms)
+{
+    fd = output_fd;
+    batch_lines = lines > 0 ? lines : 1;
+    linger = chrono::milliseconds(linger_ms > 0 ? linger_ms : 0);
+    writer = thread([this]() { run(); });
+}
+
+void LINE_WRITER::stop()
+{
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    wakeup.notify_all();
+
+    if (writer.joinable())
+        writer.join();
+}
+
+// Only the lock is taken per line; the thread takes it for as long as it needs to swap batches
+void LINE_WRITER::write(string_view line, string_view terminator)
+{
+    unique_lock<mutex> guard(lock);
+    if (stopping)
+        return;
+    if (current_lines == 0)
+        current_started = chrono::steady_clock::now();
+    current.append(line.data(), line.size());
+    current.append(terminator.data(), terminator.size());
+
+    if (++current_lines < batch_lines)
+        return;
+
+    // the output can't keep up: wait for it rather than holding more and more lines
+    room.wait(guard, [this]() { return full.size() < LINE_WRITER_MAX_BATCHES || !writer.joinable() || stopping; });
+    hand_off();
+    guard.unlock();
+    wakeup.notify_one();
+}
+
+void LINE_WRITER::flush()
+{
+    unique_lock<mutex> guard(lock);
+    if (!writer.joinable())
+        return;
+    flushing = true;
+    wakeup.notify_one();
+    room.wait(guard, [this]() { return (current.empty() && full.empty() && in_flight == 0) || stopping; });
+    flushing = false;
+}
+
+// Moves the current batch to the full ones and starts a new one in a spare buffer.
+// Called with the lock held.
+void LINE_WRITER::hand_off()
+{
+    full.push_back(move(current));
+    if (!spare.empty()) {
+        current = move(spare.back());
+        spare.pop_back();
+    } else {
+        current = string();
+    }
+    current.clear();
+    current_lines = 0;
+}
+
+void LINE_WRITER::run()
+{
+    vector<string> batches;
+    unique_lock<mutex> guard(lock);
+    while (true) {
+        // sleeps until a batch is full, or until the first line of the current one has lingered
+        auto ready = [this]() { return !full.empty() || stopping || (flushing && !current.empty()); };
+        if (current.empty())
+            wakeup.wait(guard, ready);
+        else
+            wakeup.wait_until(guard, current_started + linger, ready);
+
+        if (!current.empty() && (full.empty() || stopping || flushing || chrono::steady_clock::now() >= current_started + linger))
+            hand_off();
+        if (full.empty() && stopping)
+            break;
+
+        batches.swap(full);
+        in_flight = batches.size();
+        room.notify_all();
+        guard.unlock();
+
+        bool ok = write_batches(batches);
+
+        guard.lock();
+        for (string &batch : batches) {
+            if (spare.size() < LINE_WRITER_MAX_BATCHES)
+                spare.push_back(move(batch));
+        }
+        batches.clear();
+        in_flight = 0;
+        room.notify_all();
+
+        if (!ok) {
+            // nothing more can be written; drop what comes next instead of blocking the translator
+            cerr << "Error writing the ILF output: " << strerror(errno) << ". Further output is dropped." << endl;
+            stopping = true;
+        }
+    }
+    // lines written after the thread is gone are dropped
+    full.clear();
+    current.clear();
+    current_lines = 0;
+    room.notify_all();
+}
+
+// Writes the batches in order, resuming after partial writes. Returns false on an error.
+bool LINE_WRITER::write_batches(vector<string> &batches)
+{
+#ifndef _WIN32
+    size_t first = 0, offset = 0;
+    while (first < batches.size()) {
+        struct iovec parts[LINE_WRITER_MAX_BATCHES];
+        int count = 0;
+        for (size_t i = first; i < batches.size() && count < LINE_WRITER_MAX_BATCHES; i++, count++) {
+            size_t skip = i == first ? offset : 0;
+            parts[count].iov_base = &batches[i][skip];
+            parts[count].iov_len = batches[i].size() - skip;
+        }
+
+        ssize_t written = writev(fd, parts, count);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+        writes++;
+
+        // skips the batches written in full, and what was written of the next one
+        size_t left = written;
+        while (first < batches.size() && left >= batches[first].size() - offset) {
+            left -= batches[first].size() - offset;
+            first++;
+            offset = 0;
+        }
+        offset += left;
+    }
+#else
+    for (string &batch : batches) {
+        size_t done = 0;
+        while (done < batch.size()) {
+            int written = _write(fd, batch.data() + done, (unsigned int) (batch.size() - done));
+            if (written < 0)
+                return false;
+            writes++;
+            done += written;
+        }
+    }
+#endif
+    return true;
+}
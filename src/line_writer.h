@@ -0,0 +1,87 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+/*
+    Header file for the writer gathering ILF lines into batches written to a file descriptor
+    (standard out) from a background thread.
+*/
+
+#ifndef LINE_WRITER_H
+#define LINE_WRITER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "metrics.h"
+
+using namespace std;
+
+// Defaults of the batch size (-b) and linger time (-g)
+#define LINE_WRITER_BATCH_LINES 256
+#define LINE_WRITER_LINGER_MS 10
+
+// Full batches waiting to be written before write() blocks, and the most written in one call
+#define LINE_WRITER_MAX_BATCHES 16
+
+/*
+    Lines are appended to the current batch, which is handed to the writer thread once it holds
+    batch_lines lines or its first line has waited linger_ms. The thread writes all the batches
+    handed to it in one vectored write, so a slow reader of the output gets larger writes rather
+    than more of them. Nothing is flushed per line: a line may wait up to linger_ms before it is
+    written. With batch_lines 1 every line is handed over as soon as it is written.
+*/
+class LINE_WRITER {
+    public:
+        // counts the write calls made to the file descriptor
+        LINE_WRITER(metric &writes);
+        LINE_WRITER(const LINE_WRITER &) = delete;
+        LINE_WRITER &operator=(const LINE_WRITER &) = delete;
+        ~LINE_WRITER();
+
+        // Starts the writer thread. Lines written before start() wait for it.
+        void start(int fd, size_t batch_lines, int linger_ms);
+
+        // Writes whatever is left and stops the thread
+        void stop();
+
+        // Appends line followed by terminator, usually "\n"
+        void write(string_view line, string_view terminator);
+
+        // Waits until every line written so far has been written to the file descriptor
+        void flush();
+
+    private:
+        metric &writes;
+        int fd;
+        size_t batch_lines;
+        chrono::milliseconds linger;
+
+        mutex lock;
+        condition_variable wakeup;      // the thread: a batch is full, or stopping
+        condition_variable room;        // writers: batches were written
+        bool stopping;
+        bool flushing;
+        thread writer;
+
+        string current;
+        size_t current_lines;
+        chrono::steady_clock::time_point current_started;
+        vector<string> full;            // handed to the thread, in order
+        vector<string> spare;           // written batches, kept for their capacity
+        size_t in_flight;               // batches the thread is writing
+
+        void run();
+        void hand_off();
+        bool write_batches(vector<string> &batches);
+};
+
+#endif
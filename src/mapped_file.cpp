@@ -0,0 +1,81 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+/*
+    Class definition for the read-only view of an event log file mapped into memory.
+    Only available on POSIX systems; Windows builds stream the file instead.
+*/
+#ifndef _WIN32
+
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "mapped_file.h"
+
+MAPPED_FILE::MAPPED_FILE(const string &path)
+{
+    map = nullptr;
+    length = 0;
+    released = 0;
+
+    int fd = open(path.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        cerr << "Error opening the event log file at " << path << ": " << strerror(errno) << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    length = st.st_size;
+    if (length > 0) {
+        // private and writable so pugixml can parse slices in place; the file itself is never written
+        void *m = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (m == MAP_FAILED) {
+            cerr << "Error mapping the event log file at " << path << ": " << strerror(errno) << endl;
+            exit(EXIT_FAILURE);
+        }
+        map = (char *) m;
+        madvise(map, length, MADV_SEQUENTIAL);
+    }
+    close(fd);
+}
+
+MAPPED_FILE::~MAPPED_FILE()
+{
+    if (map != nullptr)
+        munmap(map, length);
+}
+
+char *MAPPED_FILE::data()
+{
+    return map;
+}
+
+size_t MAPPED_FILE::size()
+{
+    return length;
+}
+
+void MAPPED_FILE::release(const char *consumed_up_to)
+{
+    size_t page_size = sysconf(_SC_PAGESIZE);
+    size_t consumed  = (consumed_up_to - map) / page_size * page_size;
+
+    if (consumed < released + MAPPED_FILE_RELEASE_STEP)
+        return;
+
+    // drops both the clean file pages and any private copies made by in-place parsing
+    madvise(map + released, consumed - released, MADV_DONTNEED);
+    released = consumed;
+}
+
+#endif
@@ -0,0 +1,45 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+/*
+    Header file for the read-only view of an event log file mapped into memory.
+*/
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <stddef.h>
+
+using namespace std;
+
+// Consumed pages are handed back to the kernel in steps of this many bytes
+#define MAPPED_FILE_RELEASE_STEP (64 << 20)
+
+class MAPPED_FILE {
+    public:
+        // Maps the whole file copy-on-write, so that slices of it can be parsed in place
+        // without modifying the file. Program exits if the file can't be mapped.
+        MAPPED_FILE(const string &path);
+        MAPPED_FILE(const MAPPED_FILE &) = delete;
+        MAPPED_FILE &operator=(const MAPPED_FILE &) = delete;
+        ~MAPPED_FILE();
+
+        char *data();
+        size_t size();
+
+        // Tells the kernel that everything before the given position has been consumed, so that
+        // resident memory stays flat no matter how large the file is.
+        void release(const char *consumed_up_to);
+
+    private:
+        char *map;
+        size_t length;
+        size_t released;
+};
+
+#endif
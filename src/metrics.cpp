@@ -0,0 +1,70 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+/*
+    Class definition for the registry of named counters and gauges reported by the translator.
+*/
+#include <chrono>
+#include <tuple>
+
+#include "metrics.h"
+
+METRICS::METRICS()
+{
+    stopping = false;
+}
+
+METRICS::~METRICS()
+{
+    stop_reporting();
+}
+
+metric &METRICS::get(const string &name)
+{
+    lock_guard<mutex> guard(lock);
+    return metrics.emplace(piecewise_construct, forward_as_tuple(name), forward_as_tuple(0)).first->second;
+}
+
+void METRICS::set_max(metric &gauge, long long value)
+{
+    long long current = gauge.load(memory_order_relaxed);
+    while (value > current && !gauge.compare_exchange_weak(current, value, memory_order_relaxed));
+}
+
+void METRICS::report(ostream &out)
+{
+    lock_guard<mutex> guard(lock);
+
+    string line = "[metrics]";
+    for (auto &m : metrics)
+        line += " " + m.first + "=" + to_string(m.second.load(memory_order_relaxed));
+    out << line << endl;
+}
+
+void METRICS::start_reporting(ostream &out, int interval_seconds)
+{
+    reporter = thread([this, &out, interval_seconds]() {
+        unique_lock<mutex> guard(lock);
+        while (!reporter_wakeup.wait_for(guard, chrono::seconds(interval_seconds), [this]() { return stopping; })) {
+            guard.unlock();
+            report(out);
+            guard.lock();
+        }
+    });
+}
+
+void METRICS::stop_reporting()
+{
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    reporter_wakeup.notify_all();
+
+    if (reporter.joinable())
+        reporter.join();
+}
@@ -0,0 +1,56 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+/*
+    Header file for the registry of named counters and gauges reported by the translator.
+*/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+typedef atomic<long long> metric;
+
+class METRICS {
+    public:
+        METRICS();
+        ~METRICS();
+
+        // Returns the metric with the given name, creating it at zero on first use. The reference
+        // stays valid for the life of the registry, so hot paths look it up once and then only
+        // touch the atomic.
+        metric &get(const string &name);
+
+        // raises a gauge to the given value if it is higher
+        static void set_max(metric &gauge, long long value);
+
+        // writes all metrics on a single line, sorted by name
+        void report(ostream &out);
+
+        // reports every interval_seconds from a background thread until stop_reporting() is called
+        void start_reporting(ostream &out, int interval_seconds);
+        void stop_reporting();
+
+    private:
+        mutex lock;
+        map<string, metric> metrics;
+
+        thread reporter;
+        condition_variable reporter_wakeup;
+        bool stopping;
+};
+
+#endif
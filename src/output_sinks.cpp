@@ -0,0 +1,630 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+/*
+    Class definitions for the outputs of the translated events.
+*/
+#include <errno.h>
+#include <fcntl.h>
+#include <iostream>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#else
+#include <io.h>
+#include <sys/stat.h>
+#endif
+
+#include "output_sinks.h"
+#include "ring_sink.h"
+#include "segment_sink.h"
+
+// Reads a non-negative number, the whole of text
+static bool parse_number(const string &text, long long &number)
+{
+    if (text.empty() || text.find_first_not_of("0123456789") != string::npos || text.size() > 18)
+        return false;
+    number = stoll(text);
+    return true;
+}
+
+// Reads a number of bytes, with an optional K, M or G suffix
+static bool parse_size(const string &text, long long &bytes)
+{
+    int shift = 0;
+    string digits = text;
+    if (!digits.empty() && strchr("KMG", digits.back()) != nullptr) {
+        shift = digits.back() == 'K' ? 10 : digits.back() == 'M' ? 20 : 30;
+        digits.pop_back();
+    }
+    if (!parse_number(digits, bytes) || bytes > (1ll << 40) >> shift)
+        return false;
+    bytes <<= shift;
+    return true;
+}
+
+static bool parse_sink_option(const string &option, sink_spec &spec, string &error)
+{
+    size_t equals = option.find('=');
+    string name = option.substr(0, equals);
+    string value = equals == string::npos ? "" : option.substr(equals + 1);
+    long long number;
+
+    if (name == "format" && (value == "text" || value == "binary")) {
+        spec.format = value == "text" ? SINK_TEXT : SINK_BINARY;
+    } else if (name == "batch" && parse_number(value, number)) {
+        spec.batch_lines = number;
+    } else if (name == "linger" && parse_number(value, number)) {
+        spec.linger_ms = number;
+    } else if (spec.kind == "segments" && name == "size" && parse_size(value, number) && number > 0) {
+        spec.segment_bytes = number;
+    } else if (spec.kind == "segments" && name == "age" && parse_number(value, number)) {
+        spec.segment_seconds = number;
+    } else if (spec.kind == "segments" && name == "block" && parse_size(value, number) && number > 0 && number <= (1 << 30)) {
+        spec.block_bytes = number;
+    } else if (spec.kind == "segments" && name == "direct" && (value == "0" || value == "1")) {
+        spec.direct_io = value == "1";
+    } else if (spec.kind == "segments" && name == "fsync" && (value == "none" || value == "batch" || value == "interval")) {
+        spec.fsync = value == "none" ? SINK_FSYNC_NONE : value == "batch" ? SINK_FSYNC_BATCH : SINK_FSYNC_INTERVAL;
+    } else if (spec.kind == "segments" && name == "fsync_ms" && parse_number(value, number) && number > 0) {
+        spec.fsync_interval_ms = number;
+    } else if (spec.kind == "ring" && name == "size" && parse_size(value, number) && number > 0 && number <= (1ll << 32)) {
+        spec.ring_bytes = number;
+    } else if (spec.kind == "ring" && name == "full" && (value == "drop" || value == "block")) {
+        spec.ring_block = value == "block";
+    } else if ((spec.kind == "redis" || spec.kind == "redis_stream") && name == "queue" && parse_number(value, number) && number > 0) {
+        spec.queue_batches = number;
+    } else if ((spec.kind == "redis" || spec.kind == "redis_stream") && name == "full" && (value == "block" || value == "drop_oldest" || value == "spill")) {
+        spec.full = value == "block" ? SINK_FULL_BLOCK : value == "drop_oldest" ? SINK_FULL_DROP_OLDEST : SINK_FULL_SPILL;
+    } else if ((spec.kind == "redis" || spec.kind == "redis_stream") && name == "spill" && !value.empty()) {
+        spec.spill_path = value;
+    } else if (spec.kind == "redis_stream" && name == "maxlen" && parse_number(value, number)) {
+        spec.stream_max_length = number;
+    } else {
+        error = "Unknown option of the " + spec.kind + " sink: " + option + ". See the README for the options of each sink.";
+        return false;
+    }
+    return true;
+}
+
+bool parse_sink_specs(const string &list, const sink_spec &defaults, vector<sink_spec> &specs, string &error)
+{
+    stringstream sinks(list);
+    string text;
+    while (getline(sinks, text, ',')) {
+        sink_spec spec = defaults;
+
+        size_t question = text.find('?');
+        string options = question == string::npos ? "" : text.substr(question + 1);
+        text = text.substr(0, question);
+
+        size_t colon = text.find(':');
+        spec.kind = text.substr(0, colon);
+        spec.target = colon == string::npos ? "" : text.substr(colon + 1);
+
+        bool has_target = spec.kind == "file" || spec.kind == "segments" || spec.kind == "unix" || spec.kind == "ring";
+        if (!has_target && spec.kind != "stdout" && spec.kind != "redis" && spec.kind != "redis_stream") {
+            error = "Unknown sink: " + text + ". Expected \"stdout\", \"file:<path>\", \"segments:<directory>\", "
+                    "\"unix:<path>\", \"ring:<name>\", \"redis\" or \"redis_stream\".";
+            return false;
+        }
+        if (has_target == spec.target.empty() || (!has_target && colon != string::npos)) {
+            error = "Sink " + text + (has_target ? " needs a path." : " takes no path.");
+            return false;
+        }
+
+        // Redis messages and stream entries and ring records are the events themselves, so they
+        // can't depend on earlier frames
+        bool text_only = spec.kind == "redis" || spec.kind == "redis_stream" || spec.kind == "ring";
+        if (text_only)
+            spec.format = SINK_TEXT;
+
+        stringstream option_list(options);
+        string option;
+        while (getline(option_list, option, '&')) {
+            if (!parse_sink_option(option, spec, error))
+                return false;
+        }
+
+        if (text_only && spec.format == SINK_BINARY) {
+            error = "The " + spec.kind + " sink only takes text.";
+            return false;
+        }
+        if (spec.full == SINK_FULL_SPILL && spec.spill_path.empty()) {
+            error = "Sink " + text + " needs spill=<path> to spill its events.";
+            return false;
+        }
+        specs.push_back(spec);
+    }
+
+    if (specs.empty()) {
+        error = "No sink given.";
+        return false;
+    }
+    return true;
+}
+
+STREAM_SINK::STREAM_SINK(int fd, bool close_fd, const sink_spec &spec, metric &writes):
+    fd(fd), close_fd(close_fd), writer(writes)
+{
+    format = spec.format;
+    writer.start(fd, spec.batch_lines, spec.linger_ms);
+}
+
+STREAM_SINK::~STREAM_SINK()
+{
+    stop();
+}
+
+void STREAM_SINK::begin(string_view header)
+{
+    writer.write(header, "");
+}
+
+void STREAM_SINK::write(const rendered_event &event)
+{
+    if (format == SINK_BINARY)
+        writer.write(event.binary, "");
+    else
+        writer.write(event.text, event.terminator);
+}
+
+void STREAM_SINK::flush()
+{
+    writer.flush();
+}
+
+void STREAM_SINK::stop()
+{
+    writer.stop();
+    if (close_fd && fd >= 0) {
+#ifndef _WIN32
+        close(fd);
+#else
+        _close(fd);
+#endif
+        fd = -1;
+    }
+}
+
+QUEUED_SINK::QUEUED_SINK(const sink_spec &spec, bool terminate_lines): terminate_lines(terminate_lines)
+{
+    format = spec.format;
+    batch_lines = spec.batch_lines > 0 ? spec.batch_lines : 1;
+    linger = chrono::milliseconds(spec.linger_ms > 0 ? spec.linger_ms : 0);
+    max_batches = spec.queue_batches > 0 ? spec.queue_batches : 1;
+    full_policy = spec.full;
+    spill_path = spec.spill_path;
+}
+
+QUEUED_SINK::~QUEUED_SINK()
+{
+    stop();
+    if (spill_file != nullptr)
+        fclose(spill_file);
+}
+
+void QUEUED_SINK::start()
+{
+    consumer = thread([this]() { run(); });
+}
+
+void QUEUED_SINK::track_queue(METRICS &metrics, const string &prefix)
+{
+    queued_events = &metrics.get(prefix + "_queued_events");
+    queued_events_max = &metrics.get(prefix + "_queued_events_max");
+    blocked_us = &metrics.get(prefix + "_blocked_us");
+    dropped = &metrics.get(prefix + "_dropped");
+    spilled = &metrics.get(prefix + "_spilled");
+}
+
+// Called with the lock held
+void QUEUED_SINK::count_queued(long long change)
+{
+    queued += change;
+    queued_events->store(queued, memory_order_relaxed);
+    METRICS::set_max(*queued_events_max, queued);
+}
+
+void QUEUED_SINK::write(const rendered_event &event)
+{
+    unique_lock<mutex> guard(lock);
+    if (stopping)
+        return;
+    if (current.ends.empty()) {
+        current_started = chrono::steady_clock::now();
+        current.first_sequence = event.sequence;
+    }
+    if (format == SINK_BINARY) {
+        current.data.append(event.binary.data(), event.binary.size());
+    } else {
+        current.data.append(event.text.data(), event.text.size());
+        if (terminate_lines)
+            current.data.append(event.terminator.data(), event.terminator.size());
+    }
+    current.ends.push_back(current.data.size());
+    count_queued(1);
+
+    if (current.ends.size() < batch_lines)
+        return;
+
+    // the output can't keep up: wait for it rather than holding more and more events
+    if (full_policy == SINK_FULL_BLOCK && full.size() >= max_batches && !stopping) {
+        chrono::steady_clock::time_point blocked = chrono::steady_clock::now();
+        room.wait(guard, [this]() { return full.size() < max_batches || stopping; });
+        *blocked_us += chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - blocked).count();
+    }
+    hand_off();
+    guard.unlock();
+    wakeup.notify_one();
+}
+
+void QUEUED_SINK::flush()
+{
+    unique_lock<mutex> guard(lock);
+    flushing = true;
+    wakeup.notify_one();
+    room.wait(guard, [this]() {
+        return (current.ends.empty() && full.empty() && spilled_batches == 0 && in_flight == 0) || stopping;
+    });
+    flushing = false;
+}
+
+void QUEUED_SINK::stop()
+{
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    wakeup.notify_all();
+
+    if (consumer.joinable())
+        consumer.join();
+}
+
+chrono::steady_clock::time_point QUEUED_SINK::next_timer()
+{
+    return chrono::steady_clock::time_point::max();
+}
+
+// Moves the current batch to the full ones, making room as the policy says when the queue is full,
+// and starts a new one in a spare buffer. Called with the lock held.
+void QUEUED_SINK::hand_off()
+{
+    bool queue_full = full.size() >= max_batches;
+    if (full_policy == SINK_FULL_SPILL && (queue_full || spilled_batches > 0)) {
+        // a batch that can't be spilled is dropped rather than blocking the writer
+        if (spill(current)) {
+            *spilled += current.ends.size();
+        } else {
+            *dropped += current.ends.size();
+            count_queued(-(long long) current.ends.size());
+        }
+        current.data.clear();
+        current.ends.clear();
+        return;
+    }
+    if (full_policy == SINK_FULL_DROP_OLDEST && queue_full) {
+        *dropped += full.front().ends.size();
+        count_queued(-(long long) full.front().ends.size());
+        if (spare.size() < LINE_WRITER_MAX_BATCHES)
+            spare.push_back(move(full.front()));
+        full.erase(full.begin());
+    }
+
+    full.push_back(move(current));
+    if (!spare.empty()) {
+        current = move(spare.back());
+        spare.pop_back();
+    } else {
+        current = event_batch();
+    }
+    current.data.clear();
+    current.ends.clear();
+}
+
+void QUEUED_SINK::run()
+{
+    vector<event_batch> batches;
+    unique_lock<mutex> guard(lock);
+    while (true) {
+        // sleeps until a batch is full, the first event of the current one has lingered, or the
+        // timer of the sink is due
+        auto ready = [this]() {
+            return !full.empty() || spilled_batches > 0 || stopping || (flushing && !current.ends.empty());
+        };
+        chrono::steady_clock::time_point deadline = next_timer();
+        if (!current.ends.empty())
+            deadline = min(deadline, current_started + linger);
+        bool woken = true;
+        if (deadline == chrono::steady_clock::time_point::max())
+            wakeup.wait(guard, ready);
+        else
+            woken = wakeup.wait_until(guard, deadline, ready);
+
+        if (!current.ends.empty() && (full.empty() || stopping || flushing || chrono::steady_clock::now() >= current_started + linger))
+            hand_off();
+
+        // the batches in memory are older than the spilled ones
+        if (full.empty() && spilled_batches > 0) {
+            event_batch batch = spare.empty() ? event_batch() : move(spare.back());
+            if (!spare.empty())
+                spare.pop_back();
+            if (read_spilled(batch))
+                full.push_back(move(batch));
+        }
+        if (full.empty() && spilled_batches == 0 && stopping)
+            break;
+        if (full.empty()) {
+            if (!woken) {
+                guard.unlock();
+                on_timer();
+                guard.lock();
+            }
+            continue;
+        }
+
+        batches.swap(full);
+        in_flight = batches.size();
+        room.notify_all();
+        guard.unlock();
+
+        consume(batches);
+
+        guard.lock();
+        for (event_batch &batch : batches) {
+            count_queued(-(long long) batch.ends.size());
+            if (spare.size() < LINE_WRITER_MAX_BATCHES)
+                spare.push_back(move(batch));
+        }
+        batches.clear();
+        in_flight = 0;
+        room.notify_all();
+    }
+    room.notify_all();
+}
+
+// Appends a batch to the spill file, opening it on first use: its first sequence number, its
+// number of events and of bytes, where each event ends, and its data. Called with the lock held.
+bool QUEUED_SINK::spill(const event_batch &batch)
+{
+    if (spill_failed)
+        return false;
+    if (spill_file == nullptr && (spill_file = fopen(spill_path.c_str(), "w+b")) == nullptr) {
+        cerr << "Error opening the spill file " << spill_path << ": " << strerror(errno) << ". Events that don't fit in the queue are dropped." << endl;
+        spill_failed = true;
+        return false;
+    }
+
+    // a batch written in part is overwritten by the next one
+    uint64_t header[3] = { batch.first_sequence, batch.ends.size(), batch.data.size() };
+    vector<uint64_t> ends(batch.ends.begin(), batch.ends.end());
+    if (fseek(spill_file, spill_end, SEEK_SET) != 0 || fwrite(header, sizeof(header), 1, spill_file) != 1
+        || fwrite(ends.data(), sizeof(uint64_t), ends.size(), spill_file) != ends.size()
+        || fwrite(batch.data.data(), 1, batch.data.size(), spill_file) != batch.data.size()) {
+        if (*dropped == 0)
+            cerr << "Error writing the spill file " << spill_path << ": " << strerror(errno) << ". Events that don't fit in the queue are dropped." << endl;
+        return false;
+    }
+    spill_end += sizeof(header) + ends.size() * sizeof(uint64_t) + batch.data.size();
+    spilled_batches++;
+    return true;
+}
+
+// Reads the oldest spilled batch back into batch, and removes the file once every batch has been
+// read. A batch that can't be read is dropped. Called on the thread, with the lock held.
+bool QUEUED_SINK::read_spilled(event_batch &batch)
+{
+    uint64_t header[3];
+    bool read = fseek(spill_file, spill_read, SEEK_SET) == 0 && fread(header, sizeof(header), 1, spill_file) == 1;
+    if (read) {
+        vector<uint64_t> ends(header[1]);
+        batch.data.resize(header[2]);
+        read = fread(ends.data(), sizeof(uint64_t), ends.size(), spill_file) == ends.size()
+               && fread(&batch.data[0], 1, batch.data.size(), spill_file) == batch.data.size();
+        batch.first_sequence = header[0];
+        batch.ends.assign(ends.begin(), ends.end());
+        spill_read += sizeof(header) + ends.size() * sizeof(uint64_t) + batch.data.size();
+    }
+    spilled_batches--;
+
+    if (!read) {
+        cerr << "Error reading the spill file " << spill_path << ". The events spilled are dropped." << endl;
+        spilled_batches = 0;
+        *dropped += queued - current.ends.size();
+        count_queued(-(long long) (queued - current.ends.size()));
+    }
+    if (spilled_batches == 0) {
+        fclose(spill_file);
+        remove(spill_path.c_str());
+        spill_file = nullptr;
+        spill_read = spill_end = 0;
+    }
+    return read;
+}
+
+REDIS_SINK::REDIS_SINK(sw::redis::Redis &redis, const string &key, const sink_spec &spec, METRICS &metrics):
+    QUEUED_SINK(spec, false), redis(redis), key(key), stream(spec.kind == "redis_stream"),
+    max_length(spec.stream_max_length), published(metrics.get(stream ? "redis_stream_added" : "redis_published")),
+    failed(metrics.get(stream ? "redis_stream_failures" : "redis_publish_failures")),
+    batches_sent(metrics.get(spec.kind + "_batches")), batch_us_total(metrics.get(spec.kind + "_batch_us_total")),
+    batch_us_max(metrics.get(spec.kind + "_batch_us_max"))
+{
+    track_queue(metrics, spec.kind);
+    start();
+}
+
+REDIS_SINK::~REDIS_SINK()
+{
+    stop();
+}
+
+// Publishes or adds each batch in one pipeline. The events of a batch that can't be published, and
+// those Redis refuses, are counted and dropped rather than retried, so the translator isn't held up
+// by a lost connection; the pipeline is opened again for the next batch.
+void REDIS_SINK::consume(vector<event_batch> &batches)
+{
+    for (const event_batch &batch : batches) {
+        chrono::steady_clock::time_point started = chrono::steady_clock::now();
+        try {
+            if (!pipeline)
+                pipeline = make_unique<sw::redis::Pipeline>(redis.pipeline());
+            size_t start = 0;
+            for (size_t end : batch.ends) {
+                string_view text(batch.data.data() + start, end - start);
+                start = end;
+                if (!stream) {
+                    pipeline->publish(key, text);
+                    continue;
+                }
+                pair<string_view, string_view> entry[] = { { REDIS_STREAM_FIELD, text } };
+                if (max_length > 0)
+                    pipeline->xadd(key, "*", entry, entry + 1, max_length, true);
+                else
+                    pipeline->xadd(key, "*", entry, entry + 1);
+            }
+            // exec() doesn't throw on the error replies of single commands, e.g. NOAUTH or OOM, or
+            // WRONGTYPE when the stream key holds something else. An entry is only added once Redis
+            // replies with its id.
+            sw::redis::QueuedReplies replies = pipeline->exec();
+            size_t refused = 0;
+            for (size_t i = 0; i < replies.size(); i++) {
+                redisReply &reply = replies.get(i);
+                bool is_error = sw::redis::reply::is_error(reply);
+                if (!is_error && (!stream || reply.type == REDIS_REPLY_STRING))
+                    continue;
+                if (refused++ == 0 && failed == 0)
+                    cerr << (stream ? "Redis refused to add to the stream: " : "Redis refused to publish: ")
+                         << (is_error ? string(reply.str, reply.len) : "no entry id") << ". Refused events are dropped." << endl;
+            }
+            published += batch.ends.size() - refused;
+            failed += refused;
+        } catch (const sw::redis::Error &e) {
+            pipeline.reset();
+            if (failed.fetch_add(batch.ends.size()) == 0)
+                cerr << (stream ? "Error adding to the Redis stream: " : "Error publishing to Redis: ") << e.what()
+                     << ". Failed events are dropped." << endl;
+            continue;
+        }
+
+        long long us = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - started).count();
+        batches_sent++;
+        batch_us_total += us;
+        METRICS::set_max(batch_us_max, us);
+    }
+}
+
+#ifndef _WIN32
+// Connects to the Unix-domain stream socket listening at path
+static int connect_unix_socket(const string &path, string &error)
+{
+    struct sockaddr_un address;
+    if (path.size() >= sizeof(address.sun_path)) {
+        error = "The socket path " + path + " is too long.";
+        return -1;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *) &address, sizeof(address)) < 0) {
+        error = "Error connecting to the socket at " + path + ": " + strerror(errno);
+        if (fd >= 0)
+            close(fd);
+        return -1;
+    }
+
+    // a reader going away is reported as an error of the write rather than killing the translator
+    signal(SIGPIPE, SIG_IGN);
+    return fd;
+}
+#endif
+
+unique_ptr<OUTPUT_SINK> open_sink(const sink_spec &spec, METRICS &metrics, sw::redis::Redis *redis,
+                                  const string &channel, const string &stream, string &error)
+{
+    if (spec.kind == "stdout")
+        return make_unique<STREAM_SINK>(fileno(stdout), false, spec, metrics.get("stdout_writes"));
+
+    if (spec.kind == "file") {
+#ifndef _WIN32
+        int fd = open(spec.target.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+#else
+        int fd = _open(spec.target.c_str(), _O_WRONLY | _O_CREAT | _O_APPEND | _O_BINARY, _S_IREAD | _S_IWRITE);
+#endif
+        if (fd < 0) {
+            error = "Error opening the output file at " + spec.target + ": " + strerror(errno);
+            return nullptr;
+        }
+        return make_unique<STREAM_SINK>(fd, true, spec, metrics.get("file_writes"));
+    }
+
+    if (spec.kind == "segments") {
+#ifndef _WIN32
+        SEGMENT_SINK *segments = new SEGMENT_SINK(spec, metrics.get("segment_writes"), metrics.get("segment_fsyncs"),
+                                                  metrics.get("segments_closed"));
+        unique_ptr<OUTPUT_SINK> sink(segments);
+        if (!segments->open(error))
+            return nullptr;
+        return sink;
+#else
+        error = "Segment sinks aren't available on Windows.";
+        return nullptr;
+#endif
+    }
+
+    if (spec.kind == "ring") {
+#ifndef _WIN32
+        RING_SINK *ring = new RING_SINK(spec, metrics.get("ring_written"), metrics.get("ring_dropped"));
+        unique_ptr<OUTPUT_SINK> sink(ring);
+        if (!ring->open(error))
+            return nullptr;
+        return sink;
+#else
+        error = "Ring sinks aren't available on Windows.";
+        return nullptr;
+#endif
+    }
+
+    if (spec.kind == "unix") {
+#ifndef _WIN32
+        int fd = connect_unix_socket(spec.target, error);
+        if (fd < 0)
+            return nullptr;
+        return make_unique<STREAM_SINK>(fd, true, spec, metrics.get("unix_writes"));
+#else
+        error = "Unix-domain socket sinks aren't available on Windows.";
+        return nullptr;
+#endif
+    }
+
+    if (spec.kind == "redis") {
+        if (redis == nullptr) {
+            error = "The redis sink needs a Redis configuration.";
+            return nullptr;
+        }
+        return make_unique<REDIS_SINK>(*redis, channel, spec, metrics);
+    }
+
+    if (spec.kind == "redis_stream") {
+        if (redis == nullptr || stream.empty()) {
+            error = "The redis_stream sink needs a Redis configuration with a \"stream\" key.";
+            return nullptr;
+        }
+        return make_unique<REDIS_SINK>(*redis, stream, spec, metrics);
+    }
+
+    error = "Unknown sink: " + spec.kind;
+    return nullptr;
+}
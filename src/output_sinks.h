@@ -0,0 +1,260 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+/*
+    Header file for the outputs of the translated events: standard out, files, Unix-domain sockets
+    and Redis channels and streams, selected on the command line (-o).
+*/
+
+#ifndef OUTPUT_SINKS_H
+#define OUTPUT_SINKS_H
+
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <sw/redis++/redis++.h>
+
+#include "line_writer.h"
+#include "metrics.h"
+
+using namespace std;
+
+enum sink_format { SINK_TEXT, SINK_BINARY };
+
+// When a segment sink flushes its writes to the disk
+enum sink_fsync { SINK_FSYNC_NONE, SINK_FSYNC_BATCH, SINK_FSYNC_INTERVAL };
+
+// What a queued sink does with a batch when its queue is full: wait for room, drop the oldest batch
+// waiting, or write it to a spill file to be consumed once the queue has room
+enum sink_full { SINK_FULL_BLOCK, SINK_FULL_DROP_OLDEST, SINK_FULL_SPILL };
+
+// An event as it is rendered once for all the sinks. The views are only valid during write().
+struct rendered_event {
+    string_view text;           // ILF text
+    string_view terminator;     // written after the text by the line-oriented sinks
+    string_view binary;         // frames of the binary encoding, empty if no sink takes them
+    uint64_t sequence;          // number of the event in the run, from 1
+};
+
+// One sink of the -o list, written kind[:target][?option=value&option=value]
+struct sink_spec {
+    string kind;                // "stdout", "file", "segments", "unix", "ring", "redis" or "redis_stream"
+    string target;              // path of the file, the directory of the segments or the socket, or
+                                // name of the ring
+    sink_format format = SINK_TEXT;
+    size_t batch_lines = LINE_WRITER_BATCH_LINES;
+    int linger_ms = LINE_WRITER_LINGER_MS;
+
+    // segments only
+    uint64_t segment_bytes = 256ull << 20;  // size=<bytes>, with an optional K, M or G suffix
+    int segment_seconds = 0;                // age=<s>, 0: no rotation by time
+    size_t block_bytes = 1 << 20;           // block=<bytes>, rounded up to SEGMENT_ALIGNMENT
+    bool direct_io = false;                 // direct=1
+    sink_fsync fsync = SINK_FSYNC_NONE;     // fsync=none|batch|interval
+    int fsync_interval_ms = 1000;           // fsync_ms=<ms>
+
+    // ring only
+    size_t ring_bytes = 16 << 20;           // size=<bytes>, rounded up to a power of two
+    bool ring_block = false;                // full=drop|block
+
+    // redis and redis_stream only
+    size_t queue_batches = LINE_WRITER_MAX_BATCHES;     // queue=<batches> waiting to be consumed
+    sink_full full = SINK_FULL_BLOCK;                   // full=block|drop_oldest|spill
+    string spill_path;                                  // spill=<path>, needed by full=spill
+
+    // redis_stream only
+    long long stream_max_length = 1000000;  // maxlen=<entries>, trimmed approximately; 0: no trimming
+};
+
+// Parses a comma-separated list of sinks, e.g. "stdout,file:out.ilf?batch=4096,redis". Options not
+// given keep the values of defaults. Returns false, with the reason in error, if one is malformed.
+bool parse_sink_specs(const string &list, const sink_spec &defaults, vector<sink_spec> &specs, string &error);
+
+/*
+    Every sink queues what it is given and writes it from its own thread, in batches of batch_lines
+    events or once the first event of a batch has waited linger_ms, so a slow output doesn't hold up
+    translation until its queue is full.
+*/
+class OUTPUT_SINK {
+    public:
+        virtual ~OUTPUT_SINK() {}
+
+        sink_format get_format() const { return format; }
+
+        // Writes the start of a binary stream, before any event
+        virtual void begin(string_view header) {}
+
+        virtual void write(const rendered_event &event) = 0;
+
+        // Waits until every event written so far has left the sink
+        virtual void flush() = 0;
+
+        // Writes whatever is left and stops the sink; later events are dropped
+        virtual void stop() = 0;
+
+    protected:
+        sink_format format = SINK_TEXT;
+};
+
+// Standard out, a file or a connected Unix-domain socket, written through a LINE_WRITER
+class STREAM_SINK : public OUTPUT_SINK {
+    public:
+        // close_fd: whether the sink owns fd and closes it once stopped
+        STREAM_SINK(int fd, bool close_fd, const sink_spec &spec, metric &writes);
+        ~STREAM_SINK();
+
+        void begin(string_view header) override;
+        void write(const rendered_event &event) override;
+        void flush() override;
+        void stop() override;
+
+    private:
+        int fd;
+        bool close_fd;
+        LINE_WRITER writer;
+};
+
+// The events of a batch, one after the other, and where each one ends
+struct event_batch {
+    string data;
+    vector<size_t> ends;
+    uint64_t first_sequence = 0;
+};
+
+/*
+    Sink keeping the events it is given, in their format, in batches handed to a thread of its own
+    that consumes them. Derived classes call start() once they are ready, and stop() in their
+    destructor, before the members consume() uses are gone.
+
+    At most queue_batches batches wait for the thread. When the queue is full the writer blocks, the
+    oldest batch waiting is dropped, or the batch is appended to the spill file, as full says. Once
+    a batch is spilled, the ones that follow are spilled too until the thread has caught up, so the
+    events are still consumed in order. The spill file is read back from the thread, and emptied
+    whenever all of it has been consumed.
+*/
+class QUEUED_SINK : public OUTPUT_SINK {
+    public:
+        QUEUED_SINK(const QUEUED_SINK &) = delete;
+        QUEUED_SINK &operator=(const QUEUED_SINK &) = delete;
+        ~QUEUED_SINK();
+
+        void write(const rendered_event &event) override;
+        void flush() override;
+        void stop() override;
+
+    protected:
+        // terminate_lines: whether text events are followed by their terminator
+        QUEUED_SINK(const sink_spec &spec, bool terminate_lines);
+        void start();
+
+        // Reports the queue in metrics named after prefix: the events queued (<prefix>_queued_events,
+        // gauge, and its highest value <prefix>_queued_events_max), the microseconds writers were
+        // blocked (<prefix>_blocked_us), and the events dropped (<prefix>_dropped) and spilled
+        // (<prefix>_spilled) because the queue was full. Called before start().
+        void track_queue(METRICS &metrics, const string &prefix);
+
+        // Called on the thread, without the lock, with the batches in order
+        virtual void consume(vector<event_batch> &batches) = 0;
+
+        // Time at which the thread calls on_timer() if it has nothing to consume by then. Called on
+        // the thread, with the lock held.
+        virtual chrono::steady_clock::time_point next_timer();
+        virtual void on_timer() {}
+
+    private:
+        bool terminate_lines;
+        size_t batch_lines;
+        chrono::milliseconds linger;
+        size_t max_batches;
+        sink_full full_policy;
+        string spill_path;
+
+        mutex lock;
+        condition_variable wakeup;      // the thread: a batch is full, or stopping
+        condition_variable room;        // writers: batches were consumed
+        bool stopping = false;
+        bool flushing = false;
+        thread consumer;
+
+        event_batch current;
+        chrono::steady_clock::time_point current_started;
+        vector<event_batch> full;       // handed to the thread, in order
+        vector<event_batch> spare;      // consumed batches, kept for their capacity
+        size_t in_flight = 0;
+        size_t queued = 0;              // events written and not consumed yet, spilled ones included
+
+        FILE *spill_file = nullptr;
+        long spill_read = 0;            // offset of the first batch not read back yet
+        long spill_end = 0;
+        size_t spilled_batches = 0;     // batches in the file not read back yet
+        bool spill_failed = false;
+
+        metric untracked[5];            // stand-ins for the metrics until track_queue()
+        metric *queued_events = &untracked[0];
+        metric *queued_events_max = &untracked[1];
+        metric *blocked_us = &untracked[2];
+        metric *dropped = &untracked[3];
+        metric *spilled = &untracked[4];
+
+        void run();
+        void hand_off();
+        void count_queued(long long change);
+        bool spill(const event_batch &batch);
+        bool read_spilled(event_batch &batch);
+};
+
+// Field of the stream entries holding the ILF text of an event
+#define REDIS_STREAM_FIELD "ilf"
+
+/*
+    Publishes the text of each event to a Redis channel (redis), or adds it to a Redis stream as the
+    REDIS_STREAM_FIELD of an entry with a generated id, trimming the stream to about
+    stream_max_length entries (redis_stream). The commands of a batch are sent together in a
+    pipeline, on a connection of its own, and their replies read together, so a batch costs one
+    round trip instead of one per event.
+*/
+class REDIS_SINK : public QUEUED_SINK {
+    public:
+        // key: the channel or the stream. Counts, with metrics named after the kind of the sink, the
+        // events published (redis_published) or added (redis_stream_added), the ones Redis refused
+        // or that were lost with the connection (redis_publish_failures, redis_stream_failures), the
+        // batches sent (<kind>_batches), the time in microseconds from sending a batch to having all
+        // its replies, in total and at most (<kind>_batch_us_total, <kind>_batch_us_max), and its
+        // queue (see track_queue())
+        REDIS_SINK(sw::redis::Redis &redis, const string &key, const sink_spec &spec, METRICS &metrics);
+        ~REDIS_SINK();
+
+    protected:
+        void consume(vector<event_batch> &batches) override;
+
+    private:
+        sw::redis::Redis &redis;
+        string key;
+        bool stream;
+        long long max_length;
+        metric &published;
+        metric &failed;
+        metric &batches_sent;
+        metric &batch_us_total;
+        metric &batch_us_max;
+
+        unique_ptr<sw::redis::Pipeline> pipeline;   // opened on first use, and again after an error
+};
+
+// Opens the sink of a spec. Redis sinks publish to channel, or add to stream, with redis, which
+// outlives them. Returns null, with the reason in error, if it can't be opened.
+unique_ptr<OUTPUT_SINK> open_sink(const sink_spec &spec, METRICS &metrics, sw::redis::Redis *redis,
+                                  const string &channel, const string &stream, string &error);
+
+#endif
@@ -0,0 +1,255 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+/*
+    Class definition for the binary cache of the translation plans.
+
+    File layout, in native byte order:
+        "ILFPLANS", version (u32), key (u64), body size (u64), body, checksum of the body (u64)
+    Body:
+        plan count (u32), then for each plan:
+            id, event name, disposition (u8), field count (u32), then for each field:
+                source, split (u8), quoting (u8), key, subfield count (u32), then (name, key) pairs
+        slot count (u32), slot names
+    Strings are a length (u32) followed by their bytes.
+*/
+#include <fstream>
+#include <stdio.h>
+#include <string.h>
+#include <string_view>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "plan_cache.h"
+
+#define PLAN_CACHE_MAGIC "ILFPLANS"
+#define PLAN_CACHE_MAGIC_LEN 8
+#define PLAN_CACHE_HEADER_LEN (PLAN_CACHE_MAGIC_LEN + 4 + 8 + 8)
+
+// FNV-1a, 64 bits
+static uint64_t hash_bytes(uint64_t h, const void *bytes, size_t length)
+{
+    const unsigned char *p = (const unsigned char *) bytes;
+    for (size_t i = 0; i < length; i++) {
+        h ^= p[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
+
+#define FNV_OFFSET_BASIS 14695981039346656037ull
+
+// Appends fixed-size values and strings to the file's bytes
+struct cache_writer {
+    string bytes;
+
+    template <typename T> void put(T value) { bytes.append((const char *) &value, sizeof(value)); }
+
+    void put_string(string_view s)
+    {
+        put((uint32_t) s.size());
+        bytes.append(s.data(), s.size());
+    }
+};
+
+// Reads values back, failing (and returning zeros) instead of reading past the end
+struct cache_reader {
+    const char *p;
+    const char *end;
+    bool ok = true;
+
+    template <typename T> T get()
+    {
+        T value = T();
+        if (!ok || (size_t) (end - p) < sizeof(value)) {
+            ok = false;
+            return value;
+        }
+        memcpy(&value, p, sizeof(value));
+        p += sizeof(value);
+        return value;
+    }
+
+    string_view get_string()
+    {
+        uint32_t length = get<uint32_t>();
+        if (!ok || (size_t) (end - p) < length) {
+            ok = false;
+            return string_view();
+        }
+        string_view s(p, length);
+        p += length;
+        return s;
+    }
+};
+
+// Each file's length is hashed with it, so moving bytes from one file to the next changes the key
+uint64_t PLAN_CACHE::content_key(const vector<string> &config_contents)
+{
+    uint64_t h = FNV_OFFSET_BASIS;
+    uint32_t version = PLAN_CACHE_VERSION;
+    h = hash_bytes(h, &version, sizeof(version));
+    for (const string &contents : config_contents) {
+        uint64_t length = contents.size();
+        h = hash_bytes(h, &length, sizeof(length));
+        h = hash_bytes(h, contents.data(), contents.size());
+    }
+    return h;
+}
+
+// Rebuilds the plans from the file's bytes, and checks that they get the slots they had when saved
+static bool read_plans(const char *data, size_t size, uint64_t key, EVENT_PLANS &plans)
+{
+    cache_reader header = { data, data + size };
+    if (size < PLAN_CACHE_HEADER_LEN || memcmp(data, PLAN_CACHE_MAGIC, PLAN_CACHE_MAGIC_LEN) != 0)
+        return false;
+    header.p += PLAN_CACHE_MAGIC_LEN;
+    if (header.get<uint32_t>() != PLAN_CACHE_VERSION || header.get<uint64_t>() != key)
+        return false;
+
+    uint64_t body_size = header.get<uint64_t>();
+    if (body_size > size - PLAN_CACHE_HEADER_LEN || size - PLAN_CACHE_HEADER_LEN - body_size != sizeof(uint64_t))
+        return false;
+    const char *body = header.p;
+    uint64_t checksum;
+    memcpy(&checksum, body + body_size, sizeof(checksum));
+    if (hash_bytes(FNV_OFFSET_BASIS, body, body_size) != checksum)
+        return false;
+
+    cache_reader in = { body, body + body_size };
+    uint32_t plan_count = in.get<uint32_t>();
+    for (uint32_t i = 0; i < plan_count && in.ok; i++) {
+        event_plan &plan = plans.add(string(in.get_string()));
+        plan.event_name = in.get_string();
+        plan.disposition = (event_disposition) in.get<uint8_t>();
+
+        uint32_t field_count = in.get<uint32_t>();
+        for (uint32_t f = 0; f < field_count && in.ok; f++) {
+            field_plan field = { string(in.get_string()), -1, SPLIT_NONE, QUOTE_UNLESS_NUMBER, "", {} };
+            field.split = (field_split) in.get<uint8_t>();
+            field.quoting = (value_quoting) in.get<uint8_t>();
+            field.key = in.get_string();
+
+            uint32_t subfield_count = in.get<uint32_t>();
+            for (uint32_t s = 0; s < subfield_count && in.ok; s++) {
+                string name(in.get_string());
+                field.subfields.push_back({ name, string(in.get_string()), -1 });
+            }
+            EVENT_PLANS::assign_parts(field);
+            plan.fields.push_back(field);
+        }
+    }
+
+    plans.assign_slots();
+
+    uint32_t slot_count = in.get<uint32_t>();
+    if (!in.ok || slot_count != plans.get_slot_count())
+        return false;
+    for (uint32_t slot = 0; slot < slot_count; slot++) {
+        if (in.get_string() != plans.get_slot_name(slot) || !in.ok)
+            return false;
+    }
+    return in.p == in.end;
+}
+
+// The file is mapped read-only, so translators loading it at the same time share its pages
+bool PLAN_CACHE::load(const string &path, uint64_t key, EVENT_PLANS &plans)
+{
+    plans.clear();
+    bool loaded = false;
+
+#ifndef _WIN32
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        void *map = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (map != MAP_FAILED) {
+            loaded = read_plans((const char *) map, st.st_size, key, plans);
+            munmap(map, st.st_size);
+        }
+    }
+    close(fd);
+#else
+    ifstream file(path, ios::binary);
+    string contents((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    loaded = read_plans(contents.data(), contents.size(), key, plans);
+#endif
+
+    if (!loaded)
+        plans.clear();
+    return loaded;
+}
+
+// The file is written next to its final path and renamed over it
+bool PLAN_CACHE::save(const string &path, uint64_t key, const EVENT_PLANS &plans)
+{
+    cache_writer body;
+    vector<const event_plan *> all_plans = plans.get_plans();
+    body.put((uint32_t) all_plans.size());
+    for (const event_plan *plan : all_plans) {
+        body.put_string(plan->id);
+        body.put_string(plan->event_name);
+        body.put((uint8_t) plan->disposition);
+
+        body.put((uint32_t) plan->fields.size());
+        for (const field_plan &field : plan->fields) {
+            body.put_string(field.source);
+            body.put((uint8_t) field.split);
+            body.put((uint8_t) field.quoting);
+            body.put_string(field.key);
+
+            body.put((uint32_t) field.subfields.size());
+            for (const subfield_plan &subfield : field.subfields) {
+                body.put_string(subfield.name);
+                body.put_string(subfield.key);
+            }
+        }
+    }
+    body.put((uint32_t) plans.get_slot_count());
+    for (size_t slot = 0; slot < plans.get_slot_count(); slot++)
+        body.put_string(plans.get_slot_name(slot));
+
+    cache_writer file;
+    file.bytes.append(PLAN_CACHE_MAGIC, PLAN_CACHE_MAGIC_LEN);
+    file.put((uint32_t) PLAN_CACHE_VERSION);
+    file.put(key);
+    file.put((uint64_t) body.bytes.size());
+    file.bytes += body.bytes;
+    file.put(hash_bytes(FNV_OFFSET_BASIS, body.bytes.data(), body.bytes.size()));
+
+#ifndef _WIN32
+    string temporary_path = path + ".tmp." + to_string(getpid());
+#else
+    string temporary_path = path + ".tmp";
+#endif
+    {
+        ofstream out(temporary_path, ios::binary | ios::trunc);
+        out.write(file.bytes.data(), file.bytes.size());
+        if (!out) {
+            remove(temporary_path.c_str());
+            return false;
+        }
+    }
+
+#ifdef _WIN32
+    // rename() doesn't replace an existing file on Windows
+    remove(path.c_str());
+#endif
+    if (rename(temporary_path.c_str(), path.c_str()) != 0) {
+        remove(temporary_path.c_str());
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,45 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+/*
+    Header file for the binary cache of the translation plans compiled from the configuration files.
+*/
+
+#ifndef PLAN_CACHE_H
+#define PLAN_CACHE_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "event_plans.h"
+
+using namespace std;
+
+// Bumped whenever the file layout or the way plans are compiled changes, so older caches miss
+#define PLAN_CACHE_VERSION 1
+
+/*
+    Saves compiled plans to a file keyed by a hash of the configuration files they were compiled
+    from, so a translator started on the same files maps the file read-only and rebuilds the plans
+    without parsing any JSON. The file is replaced atomically, so translators sharing it never
+    see half of one.
+*/
+class PLAN_CACHE {
+    public:
+        // Returns the key of the given configuration file contents, in a fixed order
+        static uint64_t content_key(const vector<string> &config_contents);
+
+        // Loads the plans saved under the key. Returns false, leaving the plans cleared, if the file
+        // is missing, was saved under another key or version, or is damaged.
+        static bool load(const string &path, uint64_t key, EVENT_PLANS &plans);
+
+        // Saves the plans under the key. Returns false if the file can't be written.
+        static bool save(const string &path, uint64_t key, const EVENT_PLANS &plans);
+};
+
+#endif
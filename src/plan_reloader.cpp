@@ -0,0 +1,96 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+/*
+    Class definition for the reloader rebuilding the translation plans in the background.
+*/
+#include <signal.h>
+
+#include "plan_reloader.h"
+
+atomic<bool> PLAN_RELOADER::reload_requested(false);
+
+PLAN_RELOADER::PLAN_RELOADER()
+{
+    stopping = false;
+    has_published = false;
+}
+
+PLAN_RELOADER::~PLAN_RELOADER()
+{
+    stop();
+}
+
+void PLAN_RELOADER::start(function<shared_ptr<const EVENT_PLANS>()> build_plans)
+{
+    build = build_plans;
+#ifdef SIGHUP
+    signal(SIGHUP, handle_signal);
+#endif
+    reloader = thread([this]() { run(); });
+}
+
+void PLAN_RELOADER::stop()
+{
+    {
+        lock_guard<mutex> guard(lock);
+        stopping = true;
+    }
+    wakeup.notify_all();
+
+    if (reloader.joinable())
+        reloader.join();
+}
+
+// a signal handler can only touch lock-free atomics, so the thread polls the request instead
+// of being woken up by it
+void PLAN_RELOADER::run()
+{
+    unique_lock<mutex> guard(lock);
+    while (!wakeup.wait_for(guard, chrono::milliseconds(PLAN_RELOADER_POLL_MS), [this]() { return stopping; })) {
+        if (!reload_requested.exchange(false))
+            continue;
+
+        guard.unlock();
+        shared_ptr<const EVENT_PLANS> plans = build();
+        guard.lock();
+
+        if (plans == nullptr)
+            continue;
+        // plans published earlier but not taken yet are replaced, only the newest matter
+        published = plans;
+        published_at = chrono::steady_clock::now();
+        has_published.store(true, memory_order_release);
+    }
+}
+
+void PLAN_RELOADER::request_reload()
+{
+    reload_requested.store(true);
+}
+
+void PLAN_RELOADER::handle_signal(int)
+{
+    request_reload();
+}
+
+bool PLAN_RELOADER::take_published(shared_ptr<const EVENT_PLANS> &plans, chrono::microseconds &waited)
+{
+    shared_ptr<const EVENT_PLANS> old_plans;
+    {
+        lock_guard<mutex> guard(lock);
+        if (published == nullptr)
+            return false;
+        old_plans = move(plans);
+        plans = move(published);
+        published = nullptr;
+        has_published.store(false, memory_order_relaxed);
+        waited = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - published_at);
+    }
+    // the old plans are freed here, outside the lock, unless something else still holds them
+    return true;
+}
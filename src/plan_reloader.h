@@ -0,0 +1,79 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+/*
+    Header file for the reloader rebuilding the translation plans in the background when the
+    configuration files change.
+*/
+
+#ifndef PLAN_RELOADER_H
+#define PLAN_RELOADER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "event_plans.h"
+
+using namespace std;
+
+// How often the reloader thread checks for a reload request, in milliseconds
+#define PLAN_RELOADER_POLL_MS 100
+
+/*
+    Rebuilds the plans on its own thread each time a reload is requested (SIGHUP on POSIX systems)
+    and publishes them for the thread translating events, which swaps them in between two events.
+    An event is translated by one version of the plans from start to finish, and the translating
+    thread never waits for a rebuild: picking up new plans costs it one atomic load per event.
+    Plans are shared and immutable, so anything still holding the old version keeps it alive.
+*/
+class PLAN_RELOADER {
+    public:
+        PLAN_RELOADER();
+        ~PLAN_RELOADER();
+
+        // Starts the reloader thread, which calls build for each reload request. build returns the
+        // new plans, or nullptr if they can't be built, in which case the current ones stay in use.
+        void start(function<shared_ptr<const EVENT_PLANS>()> build);
+        void stop();
+
+        // Requests a reload, as SIGHUP does. Safe to call from a signal handler.
+        static void request_reload();
+
+        // Swaps the newest published plans into plans if there are any, and sets waited to how long
+        // they were published before being taken. Returns false, touching nothing, otherwise.
+        bool take(shared_ptr<const EVENT_PLANS> &plans, chrono::microseconds &waited)
+        {
+            if (!has_published.load(memory_order_acquire))
+                return false;
+            return take_published(plans, waited);
+        }
+
+    private:
+        function<shared_ptr<const EVENT_PLANS>()> build;
+        thread reloader;
+        mutex lock;
+        condition_variable wakeup;
+        bool stopping;
+
+        shared_ptr<const EVENT_PLANS> published;
+        chrono::steady_clock::time_point published_at;
+        atomic<bool> has_published;
+
+        // set by request_reload(), possibly from a signal handler
+        static atomic<bool> reload_requested;
+
+        void run();
+        bool take_published(shared_ptr<const EVENT_PLANS> &plans, chrono::microseconds &waited);
+        static void handle_signal(int);
+};
+
+#endif
@@ -0,0 +1,73 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+/*
+    Class definition for the sink writing the events to a ring in shared memory.
+*/
+#ifndef _WIN32
+
+#include <chrono>
+#include <thread>
+
+#include "ring_sink.h"
+
+// Attempts at writing to a full ring, with ?full=block, before waiting between attempts
+#define RING_SINK_SPINS 64
+#define RING_SINK_WAIT_US 50
+
+RING_SINK::RING_SINK(const sink_spec &spec, metric &written, metric &dropped): written(written), dropped(dropped)
+{
+    // shared memory object names start with a slash
+    name = spec.target[0] == '/' ? spec.target : "/" + spec.target;
+    requested_bytes = spec.ring_bytes;
+    block = spec.ring_block;
+}
+
+bool RING_SINK::open(string &error)
+{
+    return ring.create(name, requested_bytes, error);
+}
+
+void RING_SINK::write(const rendered_event &event)
+{
+    if (stopped)
+        return;
+    if (ring.try_write(event.text, !block)) {
+        written++;
+        return;
+    }
+    if (!block) {
+        dropped++;
+        return;
+    }
+
+    // an event bigger than the ring never fits; it is dropped rather than waited for
+    for (int attempt = 1; !ring.try_write(event.text, false); attempt++) {
+        if (ILF_RING_WRITER::record_bytes(event.text.size()) > ring.get_capacity()) {
+            dropped++;
+            return;
+        }
+        if (attempt < RING_SINK_SPINS)
+            this_thread::yield();
+        else
+            this_thread::sleep_for(chrono::microseconds(RING_SINK_WAIT_US));
+    }
+    written++;
+}
+
+// records are visible to the reader as soon as they are written
+void RING_SINK::flush()
+{
+}
+
+void RING_SINK::stop()
+{
+    stopped = true;
+    ring.close();
+}
+
+#endif
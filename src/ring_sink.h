@@ -0,0 +1,52 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+/*
+    Header file for the sink handing the events to a detection engine on the same host through a
+    ring in shared memory.
+*/
+
+#ifndef RING_SINK_H
+#define RING_SINK_H
+
+#include <string>
+
+#include "../lib/libilf/ILF/ILF_ring.h"
+#include "metrics.h"
+#include "output_sinks.h"
+
+using namespace std;
+
+/*
+    Each event's text is written to the ring as one record as soon as it is translated, on the
+    translating thread: there is no batch to wait for, and the reader is only woken when it sleeps.
+    When the ring is full the event is dropped (counted by the writer, and in the ring for the
+    reader), or with ?full=block, waited for until the reader makes room.
+*/
+class RING_SINK : public OUTPUT_SINK {
+    public:
+        // counts the events written, and the ones dropped because the ring was full
+        RING_SINK(const sink_spec &spec, metric &written, metric &dropped);
+
+        // Creates the ring. Returns false, with the reason in error, if it can't.
+        bool open(string &error);
+
+        void write(const rendered_event &event) override;
+        void flush() override;
+        void stop() override;
+
+    private:
+        string name;
+        size_t requested_bytes;         // the ring may be bigger
+        bool block;
+        bool stopped = false;
+        ILF_RING_WRITER ring;
+        metric &written;
+        metric &dropped;
+};
+
+#endif
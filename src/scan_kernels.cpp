@@ -0,0 +1,173 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+/*
+    Definition of the byte-scanning kernels used to find tags in raw Sysmon XML. The vector
+    kernels are compiled for their instruction set with target attributes and chosen at runtime,
+    so the rest of the program is built for the baseline architecture. Other compilers and
+    architectures use the scalar kernel, which relies on the C library's memchr.
+*/
+#include <string.h>
+#include <stdint.h>
+
+#include "scan_kernels.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define SCAN_KERNELS_X86
+#include <immintrin.h>
+#endif
+
+typedef const char *(*find_function)(const char *, const char *, const char *, size_t);
+
+static const char *find_scalar(const char *p, const char *end, const char *needle, size_t n)
+{
+    while (end - p >= (ptrdiff_t) n) {
+        p = (const char *) memchr(p, needle[0], end - p - n + 1);
+        if (p == NULL)
+            return end;
+        if (memcmp(p + 1, needle + 1, n - 1) == 0)
+            return p;
+        p++;
+    }
+    return end;
+}
+
+#ifdef SCAN_KERNELS_X86
+
+// Each iteration compares 16 positions: a candidate must match both the first byte of the
+// needle at p + i and the last byte at p + i + n - 1.
+__attribute__((target("sse2")))
+static const char *find_sse2(const char *p, const char *end, const char *needle, size_t n)
+{
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last  = _mm_set1_epi8(needle[n - 1]);
+
+    while (end - p >= (ptrdiff_t) (n + 15)) {
+        __m128i block_first = _mm_loadu_si128((const __m128i *) p);
+        __m128i block_last  = _mm_loadu_si128((const __m128i *) (p + n - 1));
+        uint32_t mask = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(block_first, first),
+                                                        _mm_cmpeq_epi8(block_last, last)));
+        while (mask != 0) {
+            int i = __builtin_ctz(mask);
+            if (memcmp(p + i + 1, needle + 1, n - 2) == 0)
+                return p + i;
+            mask &= mask - 1;
+        }
+        p += 16;
+    }
+    return find_scalar(p, end, needle, n);
+}
+
+// Same as the SSE2 kernel with 32 positions per iteration
+__attribute__((target("avx2")))
+static const char *find_avx2(const char *p, const char *end, const char *needle, size_t n)
+{
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last  = _mm256_set1_epi8(needle[n - 1]);
+
+    while (end - p >= (ptrdiff_t) (n + 31)) {
+        __m256i block_first = _mm256_loadu_si256((const __m256i *) p);
+        __m256i block_last  = _mm256_loadu_si256((const __m256i *) (p + n - 1));
+        uint32_t mask = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(block_first, first),
+                                                              _mm256_cmpeq_epi8(block_last, last)));
+        while (mask != 0) {
+            int i = __builtin_ctz(mask);
+            if (memcmp(p + i + 1, needle + 1, n - 2) == 0)
+                return p + i;
+            mask &= mask - 1;
+        }
+        p += 32;
+    }
+    return find_sse2(p, end, needle, n);
+}
+
+#endif
+
+static bool is_supported(scan_kernel kernel)
+{
+#ifdef SCAN_KERNELS_X86
+    // may run from a static initializer, before the runtime has probed the CPU
+    __builtin_cpu_init();
+#endif
+    switch (kernel) {
+        case SCAN_SCALAR:
+            return true;
+#ifdef SCAN_KERNELS_X86
+        case SCAN_SSE2:
+            return __builtin_cpu_supports("sse2");
+        case SCAN_AVX2:
+            return __builtin_cpu_supports("avx2");
+#endif
+        default:
+            return false;
+    }
+}
+
+static find_function get_find_function(scan_kernel kernel)
+{
+    switch (kernel) {
+#ifdef SCAN_KERNELS_X86
+        case SCAN_SSE2:
+            return find_sse2;
+        case SCAN_AVX2:
+            return find_avx2;
+#endif
+        default:
+            return find_scalar;
+    }
+}
+
+static scan_kernel best_scan_kernel()
+{
+    if (is_supported(SCAN_AVX2))
+        return SCAN_AVX2;
+    if (is_supported(SCAN_SSE2))
+        return SCAN_SSE2;
+    return SCAN_SCALAR;
+}
+
+// constant-initialized, so the scalar kernel is usable even before the best one is selected
+static scan_kernel current_kernel = SCAN_SCALAR;
+static find_function current_find = find_scalar;
+
+scan_kernel get_scan_kernel()
+{
+    return current_kernel;
+}
+
+const char *get_scan_kernel_name(scan_kernel kernel)
+{
+    switch (kernel) {
+        case SCAN_SSE2:
+            return "sse2";
+        case SCAN_AVX2:
+            return "avx2";
+        default:
+            return "scalar";
+    }
+}
+
+bool set_scan_kernel(scan_kernel kernel)
+{
+    if (!is_supported(kernel))
+        return false;
+
+    current_kernel = kernel;
+    current_find = get_find_function(kernel);
+    return true;
+}
+
+static bool best_kernel_selected = set_scan_kernel(best_scan_kernel());
+
+const char *find_substring(const char *begin, const char *end, const char *needle, size_t needle_length)
+{
+    // the vector kernels match the first and last bytes separately, so they need at least two
+    if (needle_length < 2)
+        return needle_length == 0 ? begin : find_scalar(begin, end, needle, needle_length);
+
+    return current_find(begin, end, needle, needle_length);
+}
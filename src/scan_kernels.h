@@ -0,0 +1,32 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+/*
+    Header file for the byte-scanning kernels used to find tags in raw Sysmon XML.
+*/
+
+#ifndef SCAN_KERNELS_H
+#define SCAN_KERNELS_H
+
+#include <stddef.h>
+
+// Implementations of the search. The fastest one supported by the CPU is picked at startup;
+// the others are kept selectable for tests and benchmarks.
+enum scan_kernel { SCAN_SCALAR, SCAN_SSE2, SCAN_AVX2 };
+
+scan_kernel get_scan_kernel();
+const char *get_scan_kernel_name(scan_kernel kernel);
+
+// Selects the kernel used by find_substring(). Returns false if the CPU doesn't support it.
+bool set_scan_kernel(scan_kernel kernel);
+
+// Returns a pointer to the first occurrence of the needle in [begin, end), or end if there is none.
+// The vector kernels test the needle's first and last bytes across a whole register at once and
+// only compare the remaining bytes at candidate positions.
+const char *find_substring(const char *begin, const char *end, const char *needle, size_t needle_length);
+
+#endif
@@ -0,0 +1,429 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+/*
+    Class definition for the sink archiving the events to rotating segment files.
+*/
+#ifndef _WIN32
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE     // O_DIRECT
+#endif
+
+#include <algorithm>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <iostream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../lib/libilf/ILF/ILF_binary.h"
+#include "../lib/libilf/ILF/ILF_parser.h"
+#include "segment_sink.h"
+
+#define SEGMENT_PREFIX "ilf-"
+#define SEGMENT_OPEN_SUFFIX ".open"
+
+// Reads the length and type of the binary frame at the start of frames. Returns false if there is
+// no complete frame, e.g. at the zeros padding a segment left open.
+static bool read_frame(string_view frames, size_t &size, uint8_t &type)
+{
+    uint64_t length = 0;
+    size_t used = 0;
+    for (int shift = 0; used < frames.size() && shift < 64; shift += 7) {
+        uint8_t byte = frames[used++];
+        length |= (uint64_t) (byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+            break;
+    }
+    if (length == 0 || length > frames.size() - used)
+        return false;
+    type = frames[used];
+    size = used + length;
+    return true;
+}
+
+SEGMENT_SINK::SEGMENT_SINK(const sink_spec &spec, metric &writes, metric &fsyncs, metric &closed):
+    QUEUED_SINK(spec, true), writes(writes), fsyncs(fsyncs), closed(closed)
+{
+    directory = spec.target;
+    max_bytes = spec.segment_bytes;
+    max_age = chrono::seconds(spec.segment_seconds);
+    block_bytes = (spec.block_bytes + SEGMENT_ALIGNMENT - 1) / SEGMENT_ALIGNMENT * SEGMENT_ALIGNMENT;
+    direct_io = spec.direct_io;
+    fsync_mode = spec.fsync;
+    fsync_interval = chrono::milliseconds(spec.fsync_interval_ms);
+}
+
+SEGMENT_SINK::~SEGMENT_SINK()
+{
+    stop();
+    free(block);
+}
+
+bool SEGMENT_SINK::open(string &error)
+{
+#ifndef O_DIRECT
+    if (direct_io) {
+        error = "Direct I/O isn't available on this system.";
+        return false;
+    }
+#endif
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        error = "Error creating the segment directory " + directory + ": " + strerror(errno);
+        return false;
+    }
+    DIR *entries = opendir(directory.c_str());
+    if (entries == nullptr) {
+        error = "Error opening the segment directory " + directory + ": " + strerror(errno);
+        return false;
+    }
+
+    // numbers carry on from the last segment, closed or left open by a run that didn't stop
+    vector<pair<uint64_t, string>> left_open;
+    while (struct dirent *entry = readdir(entries)) {
+        unsigned long long first, last;
+        int end = 0;
+        if (sscanf(entry->d_name, SEGMENT_PREFIX "%20llu-%20llu.ilf", &first, &last) == 2)
+            sequence_base = max(sequence_base, (uint64_t) last);
+        else if (sscanf(entry->d_name, SEGMENT_PREFIX "%20llu" SEGMENT_OPEN_SUFFIX "%n", &first, &end) == 1 && entry->d_name[end] == '\0')
+            left_open.push_back({ first, entry->d_name });
+    }
+    closedir(entries);
+
+    sort(left_open.begin(), left_open.end());
+    for (auto &segment : left_open) {
+        uint64_t last;
+        if (!recover_segment(segment.second, segment.first, last, error))
+            return false;
+        sequence_base = max(sequence_base, last);
+    }
+    if (!left_open.empty() && fsync_mode != SINK_FSYNC_NONE)
+        sync_directory();
+
+    if (posix_memalign((void **) &block, SEGMENT_ALIGNMENT, block_bytes) != 0) {
+        error = "Error allocating the segment block buffer";
+        return false;
+    }
+    start();
+    return true;
+}
+
+string SEGMENT_SINK::segment_name(uint64_t first, uint64_t last, sink_format format)
+{
+    char name[64];
+    snprintf(name, sizeof(name), SEGMENT_PREFIX "%020llu-%020llu.%s", (unsigned long long) first,
+             (unsigned long long) last, format == SINK_BINARY ? "ilfb" : "ilf");
+    return name;
+}
+
+// Closes a segment left open by a run that didn't stop: cuts it after its last complete event, and
+// renames it after the events it holds, or removes it if it holds none. last is then the sequence
+// number of its last event, or the one before first.
+bool SEGMENT_SINK::recover_segment(const string &name, uint64_t first, uint64_t &last, string &error)
+{
+    string path = directory + "/" + name;
+    int segment_fd = ::open(path.c_str(), O_RDWR);
+    string content;
+    char buffer[65536];
+    ssize_t n = 0;
+    while (segment_fd >= 0 && (n = read(segment_fd, buffer, sizeof(buffer))) != 0) {
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            break;
+        content.append(buffer, n);
+    }
+    if (segment_fd < 0 || n < 0) {
+        error = "Error reading the segment left open " + path + ": " + strerror(errno);
+        if (segment_fd >= 0)
+            close(segment_fd);
+        return false;
+    }
+
+    // what follows the last complete event is a partial write or the padding of the last block
+    bool binary = content.compare(0, ILF_BINARY_MAGIC_LEN, ILF_BINARY_MAGIC) == 0;
+    size_t size = 0;
+    uint64_t events = 0;
+    if (binary) {
+        string_view frames(content);
+        frames.remove_prefix(min(frames.size(), (size_t) ILF_BINARY_MAGIC_LEN + 1));
+        size_t frame_size;
+        uint8_t type;
+        while (read_frame(frames, frame_size, type)) {
+            if (type == ILF_FRAME_EVENT) {
+                events++;
+                size = content.size() - frames.size() + frame_size;
+            }
+            frames.remove_prefix(frame_size);
+        }
+    } else {
+        // events are cut where they parse, as their values may hold newlines and they may be
+        // followed by blank lines; one isn't complete until its line is
+        ILF_PARSER parser;
+        string_view text(content);
+        while (parser.next(text)) {
+            const char *event_end = text.data();
+            while (event_end[-1] != ']')
+                event_end--;
+            if (memchr(event_end, '\n', text.data() - event_end) == nullptr)
+                break;
+            events++;
+            size = content.size() - text.size();
+        }
+    }
+
+    last = first + events - 1;
+    if (events == 0) {
+        close(segment_fd);
+        if (unlink(path.c_str()) != 0) {
+            error = "Error removing the empty segment left open " + path + ": " + strerror(errno);
+            return false;
+        }
+        return true;
+    }
+    bool cut = ftruncate(segment_fd, size) == 0 && (fsync_mode == SINK_FSYNC_NONE || fsync(segment_fd) == 0);
+    close(segment_fd);
+    string closed_path = directory + "/" + segment_name(first, last, binary ? SINK_BINARY : SINK_TEXT);
+    if (!cut || rename(path.c_str(), closed_path.c_str()) != 0) {
+        error = "Error closing the segment left open " + path + ": " + strerror(errno);
+        return false;
+    }
+    return true;
+}
+
+// Called before any event, so the thread only reads stream_prefix once it has events
+void SEGMENT_SINK::begin(string_view header)
+{
+    stream_prefix.assign(header.data(), header.size());
+}
+
+void SEGMENT_SINK::stop()
+{
+    QUEUED_SINK::stop();
+    close_segment();
+}
+
+void SEGMENT_SINK::consume(vector<event_batch> &batches)
+{
+    for (const event_batch &batch : batches) {
+        uint64_t sequence = sequence_base + batch.first_sequence;
+        size_t start = 0;
+        for (size_t end : batch.ends) {
+            if (failed)
+                return;
+            // events aren't split across segments, so a segment only goes over its size when it
+            // holds a single event
+            uint64_t size = block_offset + block_used;
+            if (fd >= 0 && (size + (end - start) > max_bytes
+                            || (max_age.count() > 0 && chrono::steady_clock::now() >= opened + max_age)))
+                close_segment();
+            if (fd < 0 && !open_segment(sequence))
+                return;
+
+            append(batch.data.data() + start, end - start);
+            if (format == SINK_BINARY)
+                add_dictionary_frames(string_view(batch.data.data() + start, end - start));
+            last_sequence = sequence++;
+            start = end;
+        }
+    }
+
+    write_tail();
+    if (fsync_mode == SINK_FSYNC_BATCH || (fsync_mode == SINK_FSYNC_INTERVAL && chrono::steady_clock::now() >= last_sync + fsync_interval))
+        sync();
+}
+
+chrono::steady_clock::time_point SEGMENT_SINK::next_timer()
+{
+    chrono::steady_clock::time_point next = chrono::steady_clock::time_point::max();
+    if (fd >= 0 && max_age.count() > 0)
+        next = opened + max_age;
+    if (fd >= 0 && dirty && fsync_mode == SINK_FSYNC_INTERVAL)
+        next = min(next, last_sync + fsync_interval);
+    return next;
+}
+
+void SEGMENT_SINK::on_timer()
+{
+    if (fd < 0)
+        return;
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    if (max_age.count() > 0 && now >= opened + max_age)
+        close_segment();
+    else if (dirty && fsync_mode == SINK_FSYNC_INTERVAL && now >= last_sync + fsync_interval)
+        sync();
+}
+
+bool SEGMENT_SINK::open_segment(uint64_t sequence)
+{
+    char name[64];
+    snprintf(name, sizeof(name), SEGMENT_PREFIX "%020llu" SEGMENT_OPEN_SUFFIX, (unsigned long long) sequence);
+    open_path = directory + "/" + name;
+
+    // a segment of the same name holds events that aren't to be overwritten
+    int flags = O_WRONLY | O_CREAT | O_EXCL;
+#ifdef O_DIRECT
+    if (direct_io)
+        flags |= O_DIRECT;
+#endif
+    fd = ::open(open_path.c_str(), flags, 0644);
+    if (fd < 0) {
+        fail("opening " + open_path);
+        return false;
+    }
+
+#ifdef __linux__
+    // reserves the blocks of the whole segment up front; file systems without it allocate as it grows
+    fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, max_bytes);
+#endif
+
+    first_sequence = last_sequence = sequence;
+    opened = last_sync = chrono::steady_clock::now();
+    block_offset = 0;
+    block_used = 0;
+    if (format == SINK_BINARY)
+        append(stream_prefix.data(), stream_prefix.size());
+    return true;
+}
+
+// Writes what is left, cuts the padding and the preallocated space, and renames the segment
+void SEGMENT_SINK::close_segment()
+{
+    if (fd < 0)
+        return;
+    write_tail();
+    if (failed)
+        return;
+
+    if (ftruncate(fd, block_offset + block_used) != 0) {
+        fail("truncating " + open_path);
+        return;
+    }
+    if (fsync_mode != SINK_FSYNC_NONE)
+        sync();
+    if (failed)
+        return;
+    close(fd);
+    fd = -1;
+
+    string path = directory + "/" + segment_name(first_sequence, last_sequence, format);
+    if (rename(open_path.c_str(), path.c_str()) != 0) {
+        fail("renaming " + open_path + " to " + path);
+        return;
+    }
+    if (fsync_mode != SINK_FSYNC_NONE)
+        sync_directory();
+    closed++;
+}
+
+void SEGMENT_SINK::append(const char *data, size_t size)
+{
+    while (size > 0 && !failed) {
+        size_t n = min(size, block_bytes - block_used);
+        memcpy(block + block_used, data, n);
+        block_used += n;
+        data += n;
+        size -= n;
+
+        if (block_used == block_bytes && write_block(block_bytes)) {
+            block_offset += block_bytes;
+            block_used = 0;
+        }
+    }
+}
+
+// Writes the partial block at the end, and keeps what follows its last aligned offset to be
+// written again, with what comes next, at that offset
+void SEGMENT_SINK::write_tail()
+{
+    if (block_used == 0 || fd < 0 || failed)
+        return;
+    size_t size = block_used;
+    if (direct_io) {
+        size = (block_used + SEGMENT_ALIGNMENT - 1) / SEGMENT_ALIGNMENT * SEGMENT_ALIGNMENT;
+        memset(block + block_used, 0, size - block_used);
+    }
+    if (!write_block(size))
+        return;
+
+    size_t aligned = block_used / SEGMENT_ALIGNMENT * SEGMENT_ALIGNMENT;
+    memmove(block, block + aligned, block_used - aligned);
+    block_offset += aligned;
+    block_used -= aligned;
+}
+
+// Writes the first size bytes of the block at block_offset
+bool SEGMENT_SINK::write_block(size_t size)
+{
+    size_t done = 0;
+    while (done < size) {
+        ssize_t written = pwrite(fd, block + done, size - done, block_offset + done);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            fail("writing " + open_path);
+            return false;
+        }
+        writes++;
+        done += written;
+    }
+    dirty = true;
+    return true;
+}
+
+void SEGMENT_SINK::sync()
+{
+    if (fd < 0 || !dirty)
+        return;
+    if (fdatasync(fd) != 0) {
+        fail("syncing " + open_path);
+        return;
+    }
+    fsyncs++;
+    dirty = false;
+    last_sync = chrono::steady_clock::now();
+}
+
+// Makes the rename of a closed segment durable
+void SEGMENT_SINK::sync_directory()
+{
+    int directory_fd = ::open(directory.c_str(), O_RDONLY);
+    if (directory_fd < 0)
+        return;
+    if (fsync(directory_fd) == 0)
+        fsyncs++;
+    close(directory_fd);
+}
+
+// Nothing more can be written; what comes next is dropped instead of blocking the translator
+void SEGMENT_SINK::fail(const string &what)
+{
+    cerr << "Error " << what << ": " << strerror(errno) << ". Further segment output is dropped." << endl;
+    failed = true;
+    if (fd >= 0)
+        close(fd);
+    fd = -1;
+}
+
+// Keeps the dictionary frames of the binary stream, to start the next segments with them
+void SEGMENT_SINK::add_dictionary_frames(string_view frames)
+{
+    size_t size;
+    uint8_t type;
+    while (read_frame(frames, size, type)) {
+        if (type == ILF_FRAME_DICTIONARY)
+            stream_prefix.append(frames.data(), size);
+        frames.remove_prefix(size);
+    }
+}
+
+#endif
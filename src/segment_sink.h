@@ -0,0 +1,102 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+/*
+    Header file for the sink archiving the events to a directory of rotating segment files.
+*/
+
+#ifndef SEGMENT_SINK_H
+#define SEGMENT_SINK_H
+
+#include <chrono>
+#include <stdint.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "metrics.h"
+#include "output_sinks.h"
+
+using namespace std;
+
+// Alignment of the writes, of their offsets and of the block buffer, as O_DIRECT needs them
+#define SEGMENT_ALIGNMENT 4096
+
+/*
+    Events are appended to a block buffer written out in whole blocks, at aligned offsets, so the
+    disk gets a few large writes instead of one per batch. The partial block left at the end of each
+    set of batches is written too, rounded up to the alignment, and rewritten in place as it fills.
+
+    Each segment is preallocated to its maximum size, and written as ilf-<first>.open until it is
+    full or older than its maximum age. It is then cut to its size and renamed to
+    ilf-<first>-<last>.ilf (.ilfb in binary), first and last being the sequence numbers of its events,
+    zero-padded so that names sort in order. Numbers carry on from the segments already in the
+    directory, including those left open by a run that didn't stop, which are closed with the
+    events they hold in full. Binary segments start with the magic and every dictionary frame sent before their
+    first event, so each one can be decoded on its own.
+*/
+class SEGMENT_SINK : public QUEUED_SINK {
+    public:
+        // counts the write calls, the fsync calls and the segments closed
+        SEGMENT_SINK(const sink_spec &spec, metric &writes, metric &fsyncs, metric &closed);
+        ~SEGMENT_SINK();
+
+        // Creates the directory if there is none, closes the segments a previous run left open, and
+        // starts the sink. Returns false, with the reason in error, if it can't be used.
+        bool open(string &error);
+
+        void begin(string_view header) override;
+        void stop() override;
+
+        static string segment_name(uint64_t first, uint64_t last, sink_format format);
+
+    protected:
+        void consume(vector<event_batch> &batches) override;
+        chrono::steady_clock::time_point next_timer() override;
+        void on_timer() override;
+
+    private:
+        string directory;
+        uint64_t max_bytes;
+        chrono::seconds max_age;
+        size_t block_bytes;
+        bool direct_io;
+        sink_fsync fsync_mode;
+        chrono::milliseconds fsync_interval;
+        metric &writes;
+        metric &fsyncs;
+        metric &closed;
+
+        uint64_t sequence_base = 0;     // last sequence number of the segments already there
+        string stream_prefix;           // binary: written at the start of every segment
+        bool failed = false;
+
+        int fd = -1;
+        string open_path;
+        uint64_t first_sequence = 0;
+        uint64_t last_sequence = 0;
+        chrono::steady_clock::time_point opened;
+        bool dirty = false;             // written since the last fsync
+        chrono::steady_clock::time_point last_sync;
+
+        char *block = nullptr;          // bytes of the segment from block_offset, aligned
+        size_t block_used = 0;
+        uint64_t block_offset = 0;
+
+        bool recover_segment(const string &name, uint64_t first, uint64_t &last, string &error);
+        bool open_segment(uint64_t sequence);
+        void close_segment();
+        void append(const char *data, size_t size);
+        void write_tail();
+        bool write_block(size_t size);
+        void sync();
+        void sync_directory();
+        void fail(const string &what);
+        void add_dictionary_frames(string_view frames);
+};
+
+#endif
@@ -0,0 +1,527 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+/*
+    Definition of the DOM-free extraction engine for Sysmon XML events. The event is tokenized
+    in a single forward pass; only the handful of elements the translator reads are looked at,
+    and their values are returned as views into the event buffer.
+*/
+#include <string.h>
+#include <stdint.h>
+#include <algorithm>
+
+#include "sysmon_scanner.h"
+#include "scan_kernels.h"
+#include "event_plans.h"
+
+namespace {
+
+enum token_type { TOKEN_START, TOKEN_END, TOKEN_TEXT, TOKEN_CDATA, TOKEN_EOF, TOKEN_ERROR };
+
+// how a value is decoded, matching pugixml's parse_default options
+enum decode_mode { DECODE_TEXT, DECODE_ATTRIBUTE, DECODE_CDATA };
+
+struct token {
+    string_view name;       // element name for start and end tags
+    char *begin, *end;      // attributes for start tags, content for text and CDATA
+    bool self_closing;
+};
+
+bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+bool is_name_end(char c)
+{
+    return is_space(c) || c == '/' || c == '>';
+}
+
+// returns a pointer to the first occurrence of needle in [p, end), or nullptr
+char *find(char *p, char *end, const char *needle, size_t needle_length)
+{
+    char *found = (char *) find_substring(p, end, needle, needle_length);
+    return found == end ? nullptr : found;
+}
+
+// Splits the event into start tags, end tags, text and CDATA. Comments, processing
+// instructions and doctypes are skipped, as pugixml does by default.
+class XML_CURSOR {
+    public:
+        XML_CURSOR(char *begin, char *end) : p(begin), end(end) {}
+
+        token_type next(token &t)
+        {
+            while (p < end) {
+                if (*p != '<') {
+                    t.begin = p;
+                    p = (char *) memchr(p, '<', end - p);
+                    if (p == nullptr)
+                        p = end;
+                    t.end = p;
+                    return TOKEN_TEXT;
+                }
+
+                if (end - p < 2)
+                    return TOKEN_ERROR;
+
+                if (p[1] == '/')
+                    return end_tag(t);
+
+                if (p[1] == '?') {
+                    if (!skip_past("?>", 2))
+                        return TOKEN_ERROR;
+                    continue;
+                }
+
+                if (p[1] == '!') {
+                    if (end - p >= 4 && memcmp(p, "<!--", 4) == 0) {
+                        if (!skip_past("-->", 3))
+                            return TOKEN_ERROR;
+                        continue;
+                    }
+                    if (end - p >= 9 && memcmp(p, "<![CDATA[", 9) == 0) {
+                        t.begin = p + 9;
+                        char *close = find(t.begin, end, "]]>", 3);
+                        if (close == nullptr)
+                            return TOKEN_ERROR;
+                        t.end = close;
+                        p = close + 3;
+                        return TOKEN_CDATA;
+                    }
+                    if (!skip_past(">", 1))
+                        return TOKEN_ERROR;
+                    continue;
+                }
+
+                return start_tag(t);
+            }
+            return TOKEN_EOF;
+        }
+
+    private:
+        char *p, *end;
+
+        bool skip_past(const char *terminator, size_t length)
+        {
+            char *found = find(p + 2, end, terminator, length);
+            if (found == nullptr)
+                return false;
+            p = found + length;
+            return true;
+        }
+
+        token_type end_tag(token &t)
+        {
+            char *name = p + 2;
+            char *close = (char *) memchr(name, '>', end - name);
+            if (close == nullptr)
+                return TOKEN_ERROR;
+
+            char *name_end = name;
+            while (name_end < close && !is_space(*name_end))
+                name_end++;
+
+            t.name = string_view(name, name_end - name);
+            p = close + 1;
+            return TOKEN_END;
+        }
+
+        // attribute values are quoted and may contain '>', so the tag is walked attribute by attribute
+        token_type start_tag(token &t)
+        {
+            char *name = p + 1;
+            char *s = name;
+            while (s < end && !is_name_end(*s))
+                s++;
+            t.name = string_view(name, s - name);
+            t.begin = s;
+
+            while (true) {
+                while (s < end && is_space(*s))
+                    s++;
+                if (s == end)
+                    return TOKEN_ERROR;
+
+                if (*s == '>') {
+                    t.end = s;
+                    t.self_closing = false;
+                    p = s + 1;
+                    return TOKEN_START;
+                }
+                if (*s == '/') {
+                    if (end - s < 2 || s[1] != '>')
+                        return TOKEN_ERROR;
+                    t.end = s;
+                    t.self_closing = true;
+                    p = s + 2;
+                    return TOKEN_START;
+                }
+
+                char *equals = (char *) memchr(s, '=', end - s);
+                if (equals == nullptr)
+                    return TOKEN_ERROR;
+                s = equals + 1;
+                while (s < end && is_space(*s))
+                    s++;
+                if (s == end || (*s != '"' && *s != '\''))
+                    return TOKEN_ERROR;
+
+                char *close_quote = (char *) memchr(s + 1, *s, end - s - 1);
+                if (close_quote == nullptr)
+                    return TOKEN_ERROR;
+                s = close_quote + 1;
+            }
+        }
+};
+
+// writes a code point the way pugixml's utf8_writer does
+char *write_utf8(char *out, uint32_t ch)
+{
+    uint8_t *result = (uint8_t *) out;
+    if (ch < 0x80) {
+        result[0] = (uint8_t) ch;
+        return out + 1;
+    }
+    if (ch < 0x800) {
+        result[0] = (uint8_t) (0xC0 | (ch >> 6));
+        result[1] = (uint8_t) (0x80 | (ch & 0x3F));
+        return out + 2;
+    }
+    if (ch < 0x10000) {
+        result[0] = (uint8_t) (0xE0 | (ch >> 12));
+        result[1] = (uint8_t) (0x80 | ((ch >> 6) & 0x3F));
+        result[2] = (uint8_t) (0x80 | (ch & 0x3F));
+        return out + 3;
+    }
+    result[0] = (uint8_t) (0xF0 | (ch >> 18));
+    result[1] = (uint8_t) (0x80 | ((ch >> 12) & 0x3F));
+    result[2] = (uint8_t) (0x80 | ((ch >> 6) & 0x3F));
+    result[3] = (uint8_t) (0x80 | (ch & 0x3F));
+    return out + 4;
+}
+
+// Decodes the entity starting at the '&' in s. On success the replacement is written at out,
+// and both pointers are advanced past it. Unknown or malformed entities are left alone:
+// like pugixml, scanning resumes at the first character that didn't fit.
+void decode_entity(char *&s, char *end, char *&out)
+{
+    char *e = s + 1;
+
+    if (e < end && *e == '#') {
+        uint32_t ch = 0;
+        bool hex = e + 1 < end && e[1] == 'x';
+        e += hex ? 2 : 1;
+
+        char *digits = e;
+        for (; e < end; e++) {
+            unsigned int c = (unsigned char) *e;
+            if (c - '0' <= 9)
+                ch = (hex ? 16 : 10) * ch + (c - '0');
+            else if (hex && ((c | ' ') - 'a') <= 5)
+                ch = 16 * ch + ((c | ' ') - 'a' + 10);
+            else
+                break;
+        }
+        if (e < end && *e == ';' && e != digits) {
+            out = write_utf8(out, ch);
+            s = e + 1;
+            return;
+        }
+    } else {
+        static const struct { const char *name; size_t length; char c; } named[] = {
+            { "amp;", 4, '&' }, { "apos;", 5, '\'' }, { "gt;", 3, '>' }, { "lt;", 3, '<' }, { "quot;", 5, '"' }
+        };
+        size_t longest = 0;
+        for (auto &n : named) {
+            size_t matched = 0;
+            while (matched < n.length && e + matched < end && e[matched] == n.name[matched])
+                matched++;
+            if (matched == n.length) {
+                *out++ = n.c;
+                s = e + n.length;
+                return;
+            }
+            longest = max(longest, matched);
+        }
+        e += longest;
+    }
+
+    // not an entity: keep everything up to where the match failed
+    while (s < e)
+        *out++ = *s++;
+}
+
+// Decodes a value in place and returns a view of the result. Returns the value untouched
+// when there is nothing to decode, which is the common case.
+string_view decode(char *begin, char *end, decode_mode mode)
+{
+    char *s = begin;
+    while (s < end && *s != '&' && *s != '\r' && (mode != DECODE_ATTRIBUTE || (*s != '\n' && *s != '\t')))
+        s++;
+    if (s == end)
+        return string_view(begin, end - begin);
+
+    char *out = s;
+    while (s < end) {
+        char c = *s;
+        if (c == '&' && mode != DECODE_CDATA) {
+            char *before = out;
+            decode_entity(s, end, out);
+
+            // pugixml values are C strings, so a decoded NUL ends them
+            char *nul = (char *) memchr(before, '\0', out - before);
+            if (nul != nullptr)
+                return string_view(begin, nul - begin);
+        } else if (c == '\r') {
+            *out++ = mode == DECODE_ATTRIBUTE ? ' ' : '\n';
+            s++;
+            if (s < end && *s == '\n')
+                s++;
+        } else if (mode == DECODE_ATTRIBUTE && (c == '\n' || c == '\t')) {
+            *out++ = ' ';
+            s++;
+        } else {
+            *out++ = *s++;
+        }
+    }
+    return string_view(begin, out - begin);
+}
+
+// finds the value of the first attribute with the given name in a start tag's attribute list
+string_view get_attribute(const token &t, const char *name, size_t name_length)
+{
+    char *s = t.begin;
+    while (s < t.end) {
+        while (s < t.end && is_space(*s))
+            s++;
+        char *attr = s;
+        while (s < t.end && *s != '=' && !is_space(*s))
+            s++;
+        size_t attr_length = s - attr;
+
+        while (s < t.end && *s != '"' && *s != '\'')
+            s++;
+        if (s == t.end)
+            break;
+        char *value = s + 1;
+        char *close_quote = (char *) memchr(value, *s, t.end - value);
+        if (close_quote == nullptr)
+            break;
+        s = close_quote + 1;
+
+        if (attr_length == name_length && memcmp(attr, name, name_length) == 0)
+            return decode(value, close_quote, DECODE_ATTRIBUTE);
+    }
+    return string_view();
+}
+
+bool is_whitespace(const char *begin, const char *end)
+{
+    for (; begin < end; begin++)
+        if (!is_space(*begin))
+            return false;
+    return true;
+}
+
+// stores text found directly inside EventData, which has an empty name
+void store_nameless(sysmon_fields &fields, const EVENT_PLANS *plans, const event_plan *plan, const token &t, decode_mode mode)
+{
+    if (!fields.projected) {
+        fields.data.emplace_back(string_view(), decode(t.begin, t.end, mode));
+        return;
+    }
+
+    string_view *value = fields.claim(plans->find_slot(*plan, string_view()));
+    if (value != nullptr)
+        *value = decode(t.begin, t.end, mode);
+}
+
+}  // namespace
+
+void sysmon_fields::clear(size_t slot_count)
+{
+    id = computer = time = string_view();
+    data.clear();
+    projected = false;
+
+    if (values.size() < slot_count) {
+        values.resize(slot_count);
+        stamps.resize(slot_count, 0);
+    }
+
+    if (++generation == 0) {
+        fill(stamps.begin(), stamps.end(), 0);
+        generation = 1;
+    }
+}
+
+string_view *sysmon_fields::claim(int slot)
+{
+    if (slot < 0 || stamps[slot] == generation)
+        return nullptr;
+
+    stamps[slot] = generation;
+    values[slot] = string_view();
+    return &values[slot];
+}
+
+bool sysmon_fields::has_value(int slot) const
+{
+    return stamps[slot] == generation;
+}
+
+// The event is walked as a flat token stream while tracking depth. Values are taken from the same
+// places pugixml's child()/text()/attribute() would find them: the first System and EventData
+// children of the root, the first EventID, Computer and TimeCreated children of System, and for
+// each child of EventData its Name attribute and its first non-whitespace text.
+bool scan_sysmon_event(char *event, size_t length, sysmon_fields &fields,
+                       const EVENT_PLANS *plans /* = nullptr */)
+{
+    enum { SECTION_NONE, SECTION_SYSTEM, SECTION_EVENT_DATA } section = SECTION_NONE;
+
+    fields.clear(plans != nullptr ? plans->get_slot_count() : 0);
+
+    XML_CURSOR cursor(event, event + length);
+    token t;
+
+    // anything before the root element is ignored
+    token_type type;
+    do {
+        type = cursor.next(t);
+    } while (type == TOKEN_TEXT || type == TOKEN_CDATA);
+
+    if (type != TOKEN_START)
+        return false;
+    if (t.self_closing)
+        return true;
+
+    bool seen_system = false, seen_event_data = false;
+    bool seen_id = false, seen_computer = false, seen_time = false;
+
+    // the value waiting for the first text of the element open at capture_depth.
+    // the text of Data fields left out by the projection is captured into skipped, without decoding it.
+    string_view *capture = nullptr, skipped;
+    int capture_depth = 0;
+    int depth = 1;
+
+    // resolved when EventData is reached, by which point System has given the ID
+    const event_plan *plan = nullptr;
+
+    while (true) {
+        switch (cursor.next(t)) {
+            case TOKEN_START:
+                depth++;
+
+                if (depth == 2) {
+                    section = SECTION_NONE;
+                    if (t.name == "System" && !seen_system) {
+                        seen_system = true;
+                        section = SECTION_SYSTEM;
+                    } else if (t.name == "EventData" && !seen_event_data) {
+                        seen_event_data = true;
+                        section = SECTION_EVENT_DATA;
+                        if (plans != nullptr && seen_id) {
+                            plan = &plans->find(fields.id);
+                            fields.projected = true;
+                        }
+                    }
+                } else if (depth == 3 && section == SECTION_SYSTEM) {
+                    if (t.name == "EventID" && !seen_id) {
+                        seen_id = true;
+                        capture = &fields.id;
+                        capture_depth = depth;
+                    } else if (t.name == "Computer" && !seen_computer) {
+                        seen_computer = true;
+                        capture = &fields.computer;
+                        capture_depth = depth;
+                    } else if (t.name == "TimeCreated" && !seen_time) {
+                        seen_time = true;
+                        fields.time = get_attribute(t, "SystemTime", 10);
+                    }
+                } else if (depth == 3 && section == SECTION_EVENT_DATA) {
+                    string_view name = get_attribute(t, "Name", 4);
+                    if (!fields.projected) {
+                        fields.data.emplace_back(name, string_view());
+                        capture = &fields.data.back().second;
+                    } else {
+                        capture = fields.claim(plans->find_slot(*plan, name));
+                        if (capture == nullptr)
+                            capture = &skipped;
+                    }
+                    capture_depth = depth;
+                }
+
+                if (t.self_closing) {
+                    if (capture != nullptr && depth == capture_depth)
+                        capture = nullptr;
+                    depth--;
+                }
+                break;
+
+            case TOKEN_END:
+                if (capture != nullptr && depth == capture_depth)
+                    capture = nullptr;
+                if (--depth == 0)
+                    return true;
+                break;
+
+            case TOKEN_TEXT:
+                if (is_whitespace(t.begin, t.end))
+                    break;
+                if (capture != nullptr && depth == capture_depth) {
+                    if (capture != &skipped)
+                        *capture = decode(t.begin, t.end, DECODE_TEXT);
+                    capture = nullptr;
+                } else if (depth == 2 && section == SECTION_EVENT_DATA) {
+                    // stray text directly inside EventData is a nameless child to pugixml
+                    store_nameless(fields, plans, plan, t, DECODE_TEXT);
+                }
+                break;
+
+            case TOKEN_CDATA:
+                if (capture != nullptr && depth == capture_depth) {
+                    if (capture != &skipped)
+                        *capture = decode(t.begin, t.end, DECODE_CDATA);
+                    capture = nullptr;
+                } else if (depth == 2 && section == SECTION_EVENT_DATA) {
+                    store_nameless(fields, plans, plan, t, DECODE_CDATA);
+                }
+                break;
+
+            case TOKEN_EOF:
+            case TOKEN_ERROR:
+                return false;
+        }
+    }
+}
+
+// The first EventID element of an event is the one in System, which comes before EventData.
+bool peek_event_id(const char *event, size_t length, string_view &id)
+{
+    const char *end = event + length;
+    const char *p = find_substring(event, end, "<EventID", 8);
+    if (p == end)
+        return false;
+
+    p += 8;
+    if (p == end || (*p != '>' && !is_space(*p)))
+        return false;
+
+    p = (const char *) memchr(p, '>', end - p);
+    if (p == nullptr || p[-1] == '/')
+        return false;
+    p++;
+
+    // the text must run straight into the end tag
+    const char *close = (const char *) memchr(p, '<', end - p);
+    if (close == nullptr || close + 1 == end || close[1] != '/' || memchr(p, '&', close - p) != nullptr)
+        return false;
+
+    id = string_view(p, close - p);
+    return true;
+}
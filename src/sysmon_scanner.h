@@ -0,0 +1,68 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+/*
+    Header file for the DOM-free extraction engine that scans a Sysmon XML event for the
+    values the translator needs, without building a tree.
+*/
+
+#ifndef SYSMON_SCANNER_H
+#define SYSMON_SCANNER_H
+
+#include <stdint.h>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include <stddef.h>
+
+using namespace std;
+
+class EVENT_PLANS;
+
+// Values the translator reads from a single Sysmon XML event. The views point into the
+// event's buffer (or into the XML tree for the pugixml engine) and are only valid while it is.
+struct sysmon_fields {
+    string_view id;         // System/EventID
+    string_view computer;   // System/Computer
+    string_view time;       // System/TimeCreated@SystemTime
+
+    // EventData/Data@Name and text, in document order, when the event isn't projected
+    vector<pair<string_view, string_view>> data;
+
+    // When the event is projected onto its plan, the values of the Data fields the plan uses,
+    // by field slot. A slot holds a value of this event when its stamp matches the generation,
+    // so the arrays don't need clearing between events.
+    bool projected = false;
+    vector<string_view> values;
+    vector<uint32_t> stamps;
+    uint32_t generation = 0;
+
+    // starts a new event with room for the given number of slots
+    void clear(size_t slot_count);
+
+    // Returns where to store the value of a slot, or nullptr if the event already has one:
+    // like a lookup by name, the first Data element with the name wins.
+    string_view *claim(int slot);
+
+    bool has_value(int slot) const;
+};
+
+// Scans a single <Event>...</Event> element in a forward pass and stores views of its values
+// in the given fields. Entities and line endings are decoded in place, exactly as pugixml
+// does with its default parse options, so the buffer must be writable. Returns false if the
+// event is malformed.
+// With plans, an event whose ID is known by the time EventData is reached is projected: only
+// the Data fields its plan uses are stored, by slot, and the others aren't even decoded.
+bool scan_sysmon_event(char *event, size_t length, sysmon_fields &fields,
+                       const EVENT_PLANS *plans = nullptr);
+
+// Reads the EventID of a raw event without parsing or modifying it, so events can be filtered
+// before either engine runs. Returns false when the raw text might differ from the parsed value
+// (entities, CDATA, comments), in which case the event has to be parsed to know its ID.
+bool peek_event_id(const char *event, size_t length, string_view &id);
+
+#endif
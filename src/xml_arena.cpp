@@ -0,0 +1,152 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+/*
+    Class definitions for the arena that backs the memory pages of per-event pugixml documents.
+*/
+#include <stdlib.h>
+#include <algorithm>
+
+#include "xml_arena.h"
+
+// alignment of every allocation, enough for anything pugixml stores in its pages
+#define XML_ARENA_ALIGNMENT alignof(max_align_t)
+
+// arena used by pugixml allocations on this thread, if any
+static thread_local XML_ARENA *active_arena = nullptr;
+
+static void *arena_allocate(size_t size)
+{
+    return active_arena != nullptr ? active_arena->allocate(size) : malloc(size);
+}
+
+// Memory from an arena is released all at once by rewind(). Anything else (documents loaded
+// while no arena was active, or before the functions were installed) came from malloc.
+static void arena_deallocate(void *ptr)
+{
+    if (active_arena == nullptr || !active_arena->owns(ptr))
+        free(ptr);
+}
+
+// Makes an arena the active one for the lifetime of the scope
+class ARENA_SCOPE {
+    public:
+        ARENA_SCOPE(XML_ARENA &arena)
+        {
+            previous = active_arena;
+            active_arena = &arena;
+        }
+
+        ~ARENA_SCOPE()
+        {
+            active_arena = previous;
+        }
+
+    private:
+        XML_ARENA *previous;
+};
+
+XML_ARENA::XML_ARENA(size_t block_size /* = XML_ARENA_BLOCK_SIZE */)
+{
+    this->block_size = block_size;
+    current = 0;
+    offset = 0;
+    used = 0;
+    high_water = 0;
+    capacity = 0;
+}
+
+XML_ARENA::~XML_ARENA()
+{
+    for (block &b : blocks)
+        free(b.data);
+}
+
+void *XML_ARENA::allocate(size_t size)
+{
+    size = (size + XML_ARENA_ALIGNMENT - 1) & ~(XML_ARENA_ALIGNMENT - 1);
+
+    // Blocks are reused in the order they were reserved, so after a rewind the same sequence of
+    // allocations lands in the same blocks. A tail too small for the request is skipped.
+    while (current < blocks.size() && blocks[current].size - offset < size) {
+        current++;
+        offset = 0;
+    }
+
+    if (current == blocks.size()) {
+        size_t new_size = max(block_size, size);
+        char *data = (char *) malloc(new_size);
+        if (data == nullptr)
+            return nullptr;
+        blocks.push_back({ data, new_size });
+        capacity += new_size;
+    }
+
+    void *ptr = blocks[current].data + offset;
+    offset += size;
+    used += size;
+    high_water = max(high_water, used);
+    return ptr;
+}
+
+bool XML_ARENA::owns(const void *ptr) const
+{
+    const char *p = (const char *) ptr;
+    for (const block &b : blocks) {
+        if (p >= b.data && p < b.data + b.size)
+            return true;
+    }
+    return false;
+}
+
+void XML_ARENA::rewind()
+{
+    current = 0;
+    offset = 0;
+    used = 0;
+}
+
+size_t XML_ARENA::get_high_water() const
+{
+    return high_water;
+}
+
+size_t XML_ARENA::get_capacity() const
+{
+    return capacity;
+}
+
+ARENA_XML_DOCUMENT::ARENA_XML_DOCUMENT()
+{
+    static bool installed = (pugi::set_memory_management_functions(arena_allocate, arena_deallocate), true);
+    (void) installed;
+}
+
+ARENA_XML_DOCUMENT::~ARENA_XML_DOCUMENT()
+{
+    // the pages have to be handed back while the arena is active, or they would reach free()
+    ARENA_SCOPE scope(arena);
+    doc.reset();
+}
+
+pugi::xml_parse_result ARENA_XML_DOCUMENT::load_buffer_inplace(void *contents, size_t size)
+{
+    ARENA_SCOPE scope(arena);
+    doc.reset();
+    arena.rewind();
+    return doc.load_buffer_inplace(contents, size);
+}
+
+pugi::xml_node ARENA_XML_DOCUMENT::first_child() const
+{
+    return doc.first_child();
+}
+
+const XML_ARENA &ARENA_XML_DOCUMENT::get_arena() const
+{
+    return arena;
+}
@@ -0,0 +1,85 @@
+/*
+    Copyright (c) 2023 The MITRE Corporation.
+    ALL RIGHTS RESERVED. This copyright notice must
+    not be removed from this software, absent MITRE's
+    express written permission.
+*/
+
+/*
+    Header file for the arena that backs the memory pages of per-event pugixml documents.
+*/
+
+#ifndef XML_ARENA_H
+#define XML_ARENA_H
+
+#include <stddef.h>
+#include <vector>
+
+#include "../lib/pugixml-1.14/pugixml.hpp"
+
+using namespace std;
+
+// Size of the blocks the arena reserves. pugixml allocates its pages in 32 KiB steps, so a typical
+// Sysmon event fits in the first block.
+#define XML_ARENA_BLOCK_SIZE (256 << 10)
+
+/*
+    Bump allocator. Allocations are carved out of large blocks and are never freed individually;
+    rewind() makes all the blocks available again without returning them to the system.
+*/
+class XML_ARENA {
+    public:
+        XML_ARENA(size_t block_size = XML_ARENA_BLOCK_SIZE);
+        XML_ARENA(const XML_ARENA &) = delete;
+        XML_ARENA &operator=(const XML_ARENA &) = delete;
+        ~XML_ARENA();
+
+        void *allocate(size_t size);
+        bool owns(const void *ptr) const;
+        void rewind();
+
+        // most bytes handed out between two rewinds
+        size_t get_high_water() const;
+        // bytes reserved from the system
+        size_t get_capacity() const;
+
+    private:
+        struct block {
+            char *data;
+            size_t size;
+        };
+
+        vector<block> blocks;
+        size_t block_size;
+        size_t current;
+        size_t offset;
+        size_t used;
+        size_t high_water;
+        size_t capacity;
+};
+
+/*
+    An xml_document whose pages come from its own arena. pugixml only lets the allocation functions
+    be set globally, so they are installed once and route allocations to the arena that is active
+    on the calling thread, falling back to malloc/free otherwise. Each document (one per worker)
+    rewinds its arena when it loads the next event, so steady-state parsing does no heap allocation.
+*/
+class ARENA_XML_DOCUMENT {
+    public:
+        ARENA_XML_DOCUMENT();
+        ARENA_XML_DOCUMENT(const ARENA_XML_DOCUMENT &) = delete;
+        ARENA_XML_DOCUMENT &operator=(const ARENA_XML_DOCUMENT &) = delete;
+        ~ARENA_XML_DOCUMENT();
+
+        // Parses the buffer in place like xml_document::load_buffer_inplace, after discarding the previous event
+        pugi::xml_parse_result load_buffer_inplace(void *contents, size_t size);
+
+        pugi::xml_node first_child() const;
+        const XML_ARENA &get_arena() const;
+
+    private:
+        XML_ARENA arena;
+        pugi::xml_document doc;
+};
+
+#endif
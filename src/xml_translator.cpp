@@ -17,12 +17,23 @@ XML_TO_ILF::XML_TO_ILF(int argc, char *argv[])
     num_events_processed = 0;
 
     stream_type = parse_args(argc, argv);
+
+    // time taken to get the plans ready, from reading the configuration files on
+    auto plans_start = chrono::steady_clock::now();
     import_configs();
+    compile_event_plans();
+    plans_load_us = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - plans_start).count();
     
-    if (stream_type != "stdin" && stream_type != "live")
+    if (stream_type != "stdin" && stream_type != "live" && read_mode == "dom")
         load_event_file(xml_logs_path);
 
     setup_redis();
+    open_sinks();
+
+    if (metrics_interval > 0)
+        metrics.start_reporting(cerr, metrics_interval);
+
+    plan_reloader.start([this]() { return reload_event_plans(); });
 }
 
 // Constructor reads in configurations from JSON objects directly.
@@ -38,15 +49,39 @@ XML_TO_ILF::XML_TO_ILF(json _allowed_fields_json, json _event_names_json,
 
     redis_json = _redis_json;
 
+    compile_event_plans();
     load_event_file(xml_logs_path);
     
     setup_redis();
 
+    sink_spec spec;
+    spec.kind = "stdout";
+    sink_specs.push_back(spec);
+    if (redis != nullptr) {
+        spec.kind = "redis";
+        sink_specs.push_back(spec);
+    }
+    open_sinks();
+
     // from_stream = "false";
 }
 
 XML_TO_ILF::~XML_TO_ILF()
 {
+    plan_reloader.stop();
+
+    // the last events are written before the metrics count the writes, and published before
+    // the Redis connection is closed
+    stop_sinks();
+
+    if (metrics_interval >= 0) {
+        metrics.stop_reporting();
+        metrics.report(cerr);
+    } else if (num_events_unconfigured > 0 || num_events_denied > 0) {
+        cerr << "Dropped " << num_events_unconfigured << " events with no configured event name and "
+             << num_events_denied << " events on the deny list" << endl;
+    }
+
     if (redis != nullptr) 
     {
         // Close the redis connection and free the pointer
@@ -60,19 +95,56 @@ string XML_TO_ILF::get_stream_type()
     return stream_type;
 }
 
+bool XML_TO_ILF::uses_redis() const
+{
+    for (const sink_spec &spec : sink_specs) {
+        if (spec.kind == "redis" || spec.kind == "redis_stream")
+            return true;
+    }
+    return false;
+}
+
 void XML_TO_ILF::setup_redis()
 {
-    if (redis_json == NULL || redis_json == "")
+    if (redis_json.is_null() || redis_json == NULL || redis_json == "")
         return;
 
     redis_connection_options.port = redis_json["port"];
     redis_connection_options.host = redis_json["host"];
     redis_connection_options.password = redis_json["password"];
     redis_channel = redis_json["channel"];
+    if (redis_json.contains("stream"))
+        redis_stream = redis_json["stream"];
 
     redis = new sw::redis::Redis(redis_connection_options);
 }
 
+// Opens the sinks of sink_specs, exiting if one can't be opened, and starts the binary stream if
+// one of them takes it
+void XML_TO_ILF::open_sinks()
+{
+    for (const sink_spec &spec : sink_specs) {
+        string error;
+        unique_ptr<OUTPUT_SINK> sink = open_sink(spec, metrics, redis, redis_channel, redis_stream, error);
+        if (sink == nullptr) {
+            cerr << error << endl;
+            exit(EXIT_FAILURE);
+        }
+        binary_output = binary_output || spec.format == SINK_BINARY;
+        sinks.push_back(move(sink));
+    }
+
+    if (binary_output)
+        begin_binary_output();
+}
+
+void XML_TO_ILF::stop_sinks()
+{
+    for (unique_ptr<OUTPUT_SINK> &sink : sinks)
+        sink->stop();
+    sinks.clear();
+}
+
 // Loads the XML event file into a pugixml structure
 void XML_TO_ILF::load_event_file(string xml_logs_path)
 {
@@ -90,20 +162,16 @@ int XML_TO_ILF::run()
         exit(EXIT_FAILURE);
     }
 
+    if (read_mode == "mmap")
+        return run_from_mapped_file();
+
     for (xml_node event_node : root.child("Events").children()) {
-        ILF *ilf = process_event(event_node);
-        if (ilf == nullptr) {
+        take_reloaded_plans();
+        get_event_fields(event_node, event_fields);
+        if (!translate_event(event_fields)) {
             continue;
         }
-        cout << ilf->to_string() << endl;
-        num_events_processed++;
-        
-        redis->publish(redis_channel, ilf->to_string().c_str());
-        delete ilf;
-        
-        if (sleep_duration > 0) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(sleep_duration));
-        }
+        write_event("\n");
     }
 
     return 0;
@@ -117,10 +185,58 @@ int XML_TO_ILF::run_from_stdin(istream &stream)
         exit(EXIT_FAILURE);
     }
     
-    string event_string;
-    while (getline(stream, event_string))
+    return run_from_events(stream);
+}
+
+// Process events one at a time from a memory-mapped event log file. Each event is parsed
+// in place and the pages behind it are released once it's done, so memory stays flat
+// and the first event is published without waiting for the whole file to be parsed.
+int XML_TO_ILF::run_from_mapped_file()
+{
+#ifdef _WIN32
+    // no mmap; streaming the file gives the same bounded memory use
+    ifstream file(xml_logs_path, ios::binary);
+    if (!file) {
+        cerr << "Error opening the event log file at " << xml_logs_path << endl;
+        exit(EXIT_FAILURE);
+    }
+    return run_from_events(file);
+#else
+    MAPPED_FILE file(xml_logs_path);
+    char *p   = file.data();
+    char *end = p + file.size();
+
+    while (true) {
+        char *open = (char *) find_event_open(p, end);
+        if (open == end)
+            break;
+
+        char *close = (char *) find_event_close(open + EVENT_OPEN_TAG_LEN, end);
+        if (close == end) {
+            cerr << "Discarding incomplete event at the end of " << xml_logs_path << endl;
+            break;
+        }
+        p = close + EVENT_CLOSE_TAG_LEN;
+
+        run_from_buffer(open, p - open);
+        file.release(open);
+    }
+
+    return 0;
+#endif
+}
+
+// Splits the stream into events on their tags rather than by line, so pretty-printed
+// multi-line exports can be processed as they are
+int XML_TO_ILF::run_from_events(istream &stream)
+{
+    EVENT_SPLITTER splitter(stream);
+
+    char *event;
+    size_t length;
+    while (splitter.next_event(event, length))
     {
-        run_from_string(event_string);
+        run_from_buffer(event, length);
     }
     return 0;
 }
@@ -128,26 +244,96 @@ int XML_TO_ILF::run_from_stdin(istream &stream)
 // Process a single event represented as a string
 int XML_TO_ILF::run_from_string(string event_string) 
 {
-    if (!root.load_string(event_string.c_str())) {
-        cerr << "Error loading the event string: " << event_string << endl;
-    }
+    // the string is our own copy, so it can be parsed in place
+    return run_from_buffer(&event_string[0], event_string.size());
+}
 
-    ILF *ilf = process_event(root.first_child());
-    if (ilf == nullptr) {
+// Process a single event held in a mutable buffer. The buffer is parsed in place
+// and must outlive the call.
+int XML_TO_ILF::run_from_buffer(char *event_buffer, size_t length)
+{
+    take_reloaded_plans();
+
+    string_view id;
+    if (peek_event_id(event_buffer, length, id) && drop_event(event_plans->find(id)))
+        return 0;
+
+    bool extracted;
+    if (engine == "scanner") {
+        extracted = scan_event(event_buffer, length);
+    } else {
+        xml_parse_result result = event_document.load_buffer_inplace(event_buffer, length);
+        if (!result) {
+            cerr << "Error loading the event string: " << result.description() << endl;
+        }
+        METRICS::set_max(xml_arena_high_water, event_document.get_arena().get_high_water());
+        xml_arena_capacity.store(event_document.get_arena().get_capacity(), memory_order_relaxed);
+
+        get_event_fields(event_document.first_child(), event_fields);
+        extracted = true;
+    }
+    if (!extracted || !translate_event(event_fields)) {
         return 0;
     }
     
-    cout << ilf->to_string() << endl << endl;
+    write_event("\n\n");
+
+    return 0;
+}
+
+// Renders the translated event once, as text and as binary frames if a sink takes them, and
+// hands it to every sink. Line-oriented sinks write the terminator after the text.
+void XML_TO_ILF::write_event(string_view terminator)
+{
+    ilf_text.clear();
+    event_view.append_to(ilf_text);
+    rendered_event event{ilf_text, terminator, string_view(), (uint64_t) num_events_processed + 1};
+    if (binary_output) {
+        ilf_binary.clear();
+        event_view.encode(ilf_encoder, ilf_binary);
+        event.binary = ilf_binary;
+    }
+    for (unique_ptr<OUTPUT_SINK> &sink : sinks)
+        sink->write(event);
     num_events_processed++;
     
-    redis->publish(redis_channel, ilf->to_string().c_str());
-    delete ilf;
-    
     if (sleep_duration > 0) {
         std::this_thread::sleep_for(std::chrono::milliseconds(sleep_duration));
     }
+}
 
-    return 0;
+// Starts the binary stream with a dictionary of the strings every event uses: the event names
+// and keys of the plans. Strings met later, like the senders, are sent before their first event.
+void XML_TO_ILF::begin_binary_output()
+{
+    ilf_encoder.intern("*");
+    ilf_encoder.intern("event__code");
+    for (const event_plan *plan : event_plans->get_plans()) {
+        if (plan->disposition != EVENT_TRANSLATED)
+            continue;
+        ilf_encoder.intern(plan->event_name);
+        for (const field_plan &field : plan->fields) {
+            if (field.split == SPLIT_NONE)
+                ilf_encoder.intern(field.key);
+            for (const subfield_plan &subfield : field.subfields) {
+                if (subfield.part >= 0)
+                    ilf_encoder.intern(subfield.key);
+            }
+        }
+    }
+
+    ilf_binary.clear();
+    ilf_encoder.begin(ilf_binary);
+    for (unique_ptr<OUTPUT_SINK> &sink : sinks) {
+        if (sink->get_format() == SINK_BINARY)
+            sink->begin(ilf_binary);
+    }
+}
+
+void XML_TO_ILF::flush_output()
+{
+    for (unique_ptr<OUTPUT_SINK> &sink : sinks)
+        sink->flush();
 }
 
 // Returns the root of the parsed XML tree
@@ -162,187 +348,242 @@ int XML_TO_ILF::get_num_events_processed()
     return num_events_processed;
 }
 
+// Returns the current value of a metric, e.g. "events_dropped_denied"
+long long XML_TO_ILF::get_metric(const string &name)
+{
+    return metrics.get(name);
+}
+
 // processing an event involves extracting the data from the Sysmon XML event object
-// and mapping it to the ECS schema per the configuration files.
+// and mapping it to the ECS schema per the configuration files. The ILF holds copies of
+// the event's strings, so it outlives the event.
 ILF *XML_TO_ILF::process_event(xml_node event_node)
 {
-    sysmon_xml *event_xml = new sysmon_xml;
-    if (event_xml == NULL) {
-        cerr << "Error allocating memory for event_xml" << endl;
-        exit(EXIT_FAILURE);
+    get_event_fields(event_node, event_fields);
+    if (!translate_event(event_fields))
+        return nullptr;
+    return new ILF(event_view.to_ilf());
+}
+
+// processes a single event with the scanner engine, reading the values straight
+// from the event's bytes without building an XML tree. The buffer is decoded in place.
+ILF *XML_TO_ILF::process_event(char *event_buffer, size_t length)
+{
+    if (!scan_event(event_buffer, length) || !translate_event(event_fields))
+        return nullptr;
+    return new ILF(event_view.to_ilf());
+}
+
+// extracts the values of an event with the scanner engine
+bool XML_TO_ILF::scan_event(char *event_buffer, size_t length)
+{
+    if (!scan_sysmon_event(event_buffer, length, event_fields, event_plans.get())) {
+        cerr << "Error scanning the event string" << endl;
+        return false;
     }
+    return true;
+}
 
-    map<string, string> event_data;
+// maps the values extracted from an event, by either engine, to the ECS schema in the event
+// view. Returns false if the event is dropped.
+bool XML_TO_ILF::translate_event(const sysmon_fields &fields)
+{
+    const event_plan &plan = event_plans->find(fields.id);
+    if (drop_event(plan))
+        return false;
 
-    bool found_id = get_event_metadata(event_xml, event_node);
+    // the view's attributes keep their capacity from one event to the next
+    event_view.clear();
+    get_event_metadata(event_view, plan, fields);
+#ifdef GENERATED_TRANSLATORS
+    if (translators == "generated")
+        translate_generated(fields.id, fields, event_view.attributes);
+    else
+#endif
+    translate_fields(plan, fields, event_view.attributes);
 
-    if (!found_id)
-    {
-        delete event_xml;
-        return nullptr;
+    return true;
+}
+
+// gets the event metadata (event_name, sender, time) and its event code
+void XML_TO_ILF::get_event_metadata(ILF_VIEW &view, const event_plan &plan, const sysmon_fields &fields)
+{
+    view.event_type = plan.event_name;
+    view.sender     = fields.computer;
+    view.receiver   = "*";
+    view.time       = fields.time;
+    view.attributes.push_back({ "event__code", fields.id, QUOTE_NEVER });
+}
+
+// Compiles the three configuration files into a plan for each event ID, so translating an event
+// never looks anything up in the JSON objects. With "-c generated" the plans come from the
+// translators generated at build time instead, and the configuration files aren't used.
+// Program exits if the plans can't be built.
+void XML_TO_ILF::compile_event_plans()
+{
+    plans_version = 1;
+
+#ifdef GENERATED_TRANSLATORS
+    if (translators == "generated") {
+        shared_ptr<EVENT_PLANS> plans = make_shared<EVENT_PLANS>();
+        if (!plans->load_generated(generated_events, generated_event_count,
+                                   generated_slot_names, generated_slot_count)) {
+            cerr << "The generated translators don't match their plans. Regenerate them." << endl;
+            exit(EXIT_FAILURE);
+        }
+        plans->deny(denied_event_ids);
+        event_plans = plans;
+        return;
     }
+#endif
 
-    get_event_data(event_node, &event_data);
-    get_field_values(event_xml, &event_data);
+    if (!plan_cache_path.empty()) {
+        event_plans = load_event_plans();
+        if (event_plans == nullptr)
+            exit(EXIT_FAILURE);
+        return;
+    }
 
-    ILF *ilf = new ILF(event_xml->event_name, 
-                    event_xml->sender, 
-                    "*", 
-                    event_xml->time, 
-                    event_xml->event_data);
-    
-    delete event_xml;
-    
-    return ilf;
+    shared_ptr<EVENT_PLANS> plans = make_shared<EVENT_PLANS>();
+    if (!plans->compile(event_names_json, allowed_fields_json, field_mappings_json, denied_event_ids))
+        exit(EXIT_FAILURE);
+    event_plans = plans;
 }
 
-// gets and stores event metadata (id, event_name, sender, time) in the sysmon_xml object
-bool XML_TO_ILF::get_event_metadata(sysmon_xml *event_xml, xml_node event_node)
+// Builds the plans from the configuration files as they are on disk now. With a plan cache (-k)
+// they are loaded from it if it was saved from files with the same contents, and otherwise
+// compiled and saved for the next start; the deny list isn't part of the cache, so it is applied
+// after loading. Returns nullptr if a file can't be parsed or has the wrong types.
+shared_ptr<const EVENT_PLANS> XML_TO_ILF::load_event_plans()
 {
-    event_xml->id = event_node.child("System").child("EventID").text().get();
-    event_xml->event_data.push_back(key_val("event__code", event_xml->id));
+    string allowed_fields_path = allowed_fields_base_path + allowed_fields_config_path;
+    string field_mappings_path = field_mappings_base_path + field_mappings_config_path;
+    string event_names_path    = event_names_base_path + event_names_config_path;
+
+    string allowed_fields = read_config(allowed_fields_path);
+    string field_mappings = read_config(field_mappings_path);
+    string event_names    = read_config(event_names_path);
+
+    shared_ptr<EVENT_PLANS> plans = make_shared<EVENT_PLANS>();
+    uint64_t key = PLAN_CACHE::content_key({ allowed_fields, field_mappings, event_names });
+    if (!plan_cache_path.empty() && PLAN_CACHE::load(plan_cache_path, key, *plans)) {
+        plan_cache_hit = 1;
+        plans->deny(denied_event_ids);
+        return plans;
+    }
+
+    // parse the contents that were hashed, in case the files change in the meantime
+    json allowed_fields_config, field_mappings_config, event_names_config;
+    if (!parse_config(allowed_fields_path, allowed_fields, allowed_fields_config) ||
+        !parse_config(field_mappings_path, field_mappings, field_mappings_config) ||
+        !parse_config(event_names_path, event_names, event_names_config))
+        return nullptr;
 
-    event_xml->sender = event_node.child("System").child("Computer").text().get();
-    event_xml->time = event_node.child("System").child("TimeCreated").attribute("SystemTime").value();
+    if (plan_cache_path.empty()) {
+        if (!plans->compile(event_names_config, allowed_fields_config, field_mappings_config, denied_event_ids))
+            return nullptr;
+        return plans;
+    }
 
-    try {
-        event_xml->event_name = event_names_json.at(event_xml->id);
-    } catch (const json::out_of_range &e) {
-        cerr << "Exception in get_event_metadata() for event #: " << event_xml->id << ". " << e.what() << endl;
-        return false;
+    plan_cache_hit = 0;
+    if (!plans->compile(event_names_config, allowed_fields_config, field_mappings_config, {}))
+        return nullptr;
+    if (!PLAN_CACHE::save(plan_cache_path, key, *plans))
+        cerr << "Could not write the plan cache at " << plan_cache_path << endl;
+    plans->deny(denied_event_ids);
+    return plans;
+}
+
+// Builds new plans on the reloader's thread when a reload is requested (SIGHUP). If they can't be
+// built, the current plans stay in use.
+shared_ptr<const EVENT_PLANS> XML_TO_ILF::reload_event_plans()
+{
+    auto reload_start = chrono::steady_clock::now();
+
+    shared_ptr<const EVENT_PLANS> plans;
+#ifdef GENERATED_TRANSLATORS
+    if (translators == "generated")
+        cerr << "The generated translators can't be reloaded. Rebuild them instead." << endl;
+    else
+#endif
+    plans = load_event_plans();
+
+    if (plans == nullptr) {
+        plans_reload_failures++;
+        cerr << "Could not reload the configuration files. The current plans stay in use." << endl;
+        return nullptr;
     }
-    return true;
+
+    plans_load_us = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - reload_start).count();
+    cerr << "Reloaded the configuration files in " << plans_load_us << " us" << endl;
+    return plans;
 }
 
-// loops through the allowed Sysmon fields specified in the config file for this event, maps them
-// to their corresponding ECS fields, finds their values in the given event data map, and adds them
-// to the sysmon_xml object's vector of attributes.
-void XML_TO_ILF::get_field_values(sysmon_xml *event_xml, map<string, string> *event_data)
-{
-    for (string allowed_field : allowed_fields_json.at(event_xml->id)) {
-        try {
-            string &allowed_field_value = event_data->at(allowed_field);
-
-            // get the mapping to the ECS field for the allowed Sysmon field
-            auto ecs_field_object = field_mappings_json.at(event_xml->id).at(allowed_field);
-
-            // Case 1: ECS field is a string
-            if (!ecs_field_object.is_array()) {
-                event_xml->event_data.push_back(key_val(replace_periods(ecs_field_object), 
-                                                        quote_string(allowed_field_value)));
-            
-            // Case 2: ECS field is an array of strings (1:many mapping)
-            } else {
-                map<string, pair<string, string>> allowed_ecs_map;
-                
-                auto ecs_fields = ecs_field_object.template get<vector<string>>();
-                for (auto ecs_field_name : ecs_fields)
-                    get_1_many_fields(&allowed_ecs_map, ecs_field_name);
-                
-                // parse the XML values for the Sysmon fields "Hashes", "Hash", "User"
-                stringstream allowed_field_value_stream(allowed_field_value);
-                if (allowed_field == HASHES || allowed_field == HASH)
-                    parse_XML_hashes(allowed_field_value_stream, allowed_ecs_map, event_xml);
-                else if (allowed_field == USER)
-                    parse_XML_user(allowed_field_value_stream, allowed_ecs_map, event_xml);
-            }       
-        } catch(...) { }
-    }
-}
-
-// parses the text in the XML data node for the "User" field, delimited by a '\',
-// and adds the field values to the map of allowed user fields.
-// also adds them to the event_xml struct.
-void XML_TO_ILF::parse_XML_user(stringstream &allowed_field_value_stream, 
-                    map<string, pair<string, string>> &allowed_user_fields_map, 
-                    sysmon_xml *event_xml)
-{
-    string domain, name;
-    getline(allowed_field_value_stream, domain, '\\');
-    
-    // no value present for this field in XML event
-    if (domain == "-")
+// Swaps in the plans the reloader has published, if any. Called before each event, so no event
+// sees two versions of the plans.
+void XML_TO_ILF::take_reloaded_plans()
+{
+    chrono::microseconds waited;
+    if (!plan_reloader.take(event_plans, waited))
         return;
 
-    getline(allowed_field_value_stream, name);
-
-    try{
-        allowed_user_fields_map.at("name").second   = name;
-        allowed_user_fields_map.at("domain").second = domain;
-    } catch (...) { }
-
-    for (auto &e: allowed_user_fields_map) {
-        event_xml->event_data.push_back(key_val(replace_periods(e.second.first), 
-                                                quote_string(e.second.second)));
-    }
-    allowed_field_value_stream.clear();
-}
-
-// parses the XML list of hash pairs (hash_type=hash_value) stored as a comma-delimited string
-// in the event, and adds the hash_values to the map of allowed hash types.
-// also adds them to the event_xml struct.
-void XML_TO_ILF::parse_XML_hashes(stringstream &allowed_field_value_stream, 
-                      map<string, pair<string, string>> &allowed_ecs_hashes_map, 
-                      sysmon_xml *event_xml)
-{  
-    string hash_element;
-    while(getline(allowed_field_value_stream, hash_element, ',')) {
-        stringstream hash_element_stream(hash_element);
-        string key, value;
-        getline(hash_element_stream, key, '=');
-        getline(hash_element_stream, value);
-        ::transform(key.begin(), key.end(), key.begin(), ::tolower);
-        try {
-            allowed_ecs_hashes_map.at(key).second = value;
-        } catch(...) { }
-    };
-
-    // only add subfields that are actually included in the XML event 
-    // (i.e not the empty string in map)
-    for (auto &e : allowed_ecs_hashes_map) {
-        string hash_val = e.second.second;
-        if (hash_val != "") {
-            event_xml->event_data.push_back(key_val(replace_periods(e.second.first), 
-                                                    quote_string(hash_val, true)));
-        }
+    plans_version++;
+    plans_swap_us = waited.count();
+}
+
+// returns true, and counts the drop, if events with the given plan aren't translated
+bool XML_TO_ILF::drop_event(const event_plan &plan)
+{
+    switch (plan.disposition) {
+        case EVENT_TRANSLATED:
+            return false;
+        case EVENT_DENIED:
+            num_events_denied++;
+            return true;
+        default:
+            num_events_unconfigured++;
+            return true;
     }
-    allowed_field_value_stream.clear();
 }
 
-// stores in a map all the allowed subfields that a single Sysmon field maps to from the config file,
-// uses the subfield as the key and (full_ecs_field, "") as the value.
-// e.g "md5" as the key and ("file.hash.md5", "") as the value
-// e.g "name" as the key and ("user.name", "") as the value
-void XML_TO_ILF::get_1_many_fields(map<string, pair<string, string>> *_map, string ecs_field_name)
+// extracts the values the translator needs from the XML tree of an event (pugixml engine),
+// storing the Data fields its plan uses in their slots and leaving out the others.
+// the views point into the tree and are valid until the document is reloaded.
+void XML_TO_ILF::get_event_fields(xml_node event, sysmon_fields &fields)
 {
-    stringstream stream(ecs_field_name);
+    fields.clear(event_plans->get_slot_count());
 
-    string subfield;
-    while(getline(stream, subfield, '.'));
+    xml_node system = event.child("System");
+    fields.id       = system.child("EventID").text().get();
+    fields.computer = system.child("Computer").text().get();
+    fields.time     = system.child("TimeCreated").attribute("SystemTime").value();
 
-    _map->insert({subfield, make_pair(ecs_field_name, "")});
-}
+    const event_plan &plan = event_plans->find(fields.id);
+    fields.projected = true;
 
-// retrieves and stores all the event data from a given XML event into a given map
-// Example of a data node: <Data Name='ProcessGuid'>{cc8aad4b-7121-654d-9a09-000000000a00}</Data>
-void XML_TO_ILF::get_event_data(xml_node event, map<string, string> *_map)
-{
     for (xml_node data_node : event.child("EventData").children()) {
-        string field_name  = data_node.attribute("Name").value();
-        string field_value = data_node.text().get();
-        _map->insert({field_name, field_value});
+        string_view *value = fields.claim(event_plans->find_slot(plan, data_node.attribute("Name").value()));
+        if (value != nullptr)
+            *value = data_node.text().get();
     }
 }
 
 // Imports the three configuration JSON files provided by the user on the CLI:
 // allowed fields JSON, field mappings JSON, and event names mapping JSON.
 // Also reads in the redis configurations.
+// The generated translators don't need the first three, and with a plan cache they are only
+// parsed if the cache misses.
 void XML_TO_ILF::import_configs()
 {
-    import_config(allowed_fields_base_path + allowed_fields_config_path, allowed_fields_json);
-    import_config(field_mappings_base_path + field_mappings_config_path, field_mappings_json);
-    import_config(event_names_base_path + event_names_config_path, event_names_json);
-    import_config(redis_config_path, redis_json);
+    if (translators != "generated" && plan_cache_path.empty()) {
+        import_config(allowed_fields_base_path + allowed_fields_config_path, allowed_fields_json);
+        import_config(field_mappings_base_path + field_mappings_config_path, field_mappings_json);
+        import_config(event_names_base_path + event_names_config_path, event_names_json);
+    }
+
+    // a run without a redis sink needs no Redis configuration
+    if (uses_redis())
+        import_config(redis_config_path, redis_json);
 }
 
 // Imports a configuration file at the given path and stores its contents in an empty JSON object 
@@ -358,37 +599,30 @@ void XML_TO_ILF::import_config(string path, json &j)
     }
 }
 
-// replaces periods in the given event attribute keys with two underscores
-string XML_TO_ILF::replace_periods(string key)
+// Reads a configuration file into a string, which is empty if the file can't be read
+string XML_TO_ILF::read_config(const string &path)
 {
-    return regex_replace(key, regex("[.]"), "__");
+    ifstream i(path, ios::binary);
+    return string((istreambuf_iterator<char>(i)), istreambuf_iterator<char>());
 }
 
-// retuns a quoted string if given string doesn't represent a number.
-// handles the case where the value represents a hash that needs to be quoted.
-string XML_TO_ILF::quote_string(string s, bool isHash /* = false */)
+// Parses the contents of the configuration file at the given path into an empty JSON object.
+// Returns false if there's an issue deserializing them.
+bool XML_TO_ILF::parse_config(const string &path, const string &contents, json &j)
 {
-    if (isNumber(s) && !isHash)
-        return s;
-    
-    ostringstream oss;
-    oss << quoted(s);
-    return oss.str();
+    try {
+        j = json::parse(contents);
+    } catch (const json::parse_error &e) {
+        cerr << "Exception in import_config() with path: " << path << ". " << e.what() << endl;
+        return false;
+    }
+    return true;
 }
 
-// determines if a string represents a number (as decimal or hex) or not.
-bool XML_TO_ILF::isNumber(const string& s)
+// replaces periods in the given event attribute keys with two underscores
+string XML_TO_ILF::replace_periods(string key)
 {
-    // hex
-    if (s[0] == '0' && s[1] == 'x')
-        return true;
-    
-    // decimal
-    for (char const &ch : s) {
-        if (!isdigit(ch) && ch != '.') 
-            return false;
-    }
-    return true;
+    return regex_replace(key, regex("[.]"), "__");
 }
 
 // wrapper for parsing all the command line arguments.
@@ -413,6 +647,74 @@ string XML_TO_ILF::parse_args(int argc, char *argv[])
     event_names_config_path = args.count("-e") ? args["-e"] : event_names_config_path;
     sleep_duration = args.count("-s") ? stoi(args["-s"]) : sleep_duration;
     xml_logs_path = args.count("-l") ? args["-l"] : xml_logs_path;
+    read_mode = args.count("-r") ? args["-r"] : read_mode;
+    engine = args.count("-p") ? args["-p"] : engine;
+    metrics_interval = args.count("-t") ? stoi(args["-t"]) : metrics_interval;
+    translators = args.count("-c") ? args["-c"] : translators;
+    plan_cache_path = args.count("-k") ? args["-k"] : plan_cache_path;
+    output_batch_lines = args.count("-b") ? stoul(args["-b"]) : output_batch_lines;
+    output_linger_ms = args.count("-g") ? stoi(args["-g"]) : output_linger_ms;
+    stdout_echo = args.count("-q") ? args["-q"] == "0" : stdout_echo;
+    output_format = args.count("-w") ? args["-w"] : output_format;
+    output_list = args.count("-o") ? args["-o"] : (stdout_echo ? "stdout,redis" : "redis");
+
+    // comma-separated event IDs that are dropped even if they are configured
+    if (args.count("-d")) {
+        stringstream deny_list(args["-d"]);
+        string id;
+        while (getline(deny_list, id, ','))
+            denied_event_ids.insert(id);
+    }
+
+    if (engine != "pugixml" && engine != "scanner") {
+        cerr << "Unknown engine: " << engine << ". Expected \"pugixml\" or \"scanner\"." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+#ifdef GENERATED_TRANSLATORS
+    if (translators != "json" && translators != "generated") {
+        cerr << "Unknown translators: " << translators << ". Expected \"json\" or \"generated\"." << endl;
+#else
+    if (translators != "json") {
+        cerr << "Unknown translators: " << translators << ". Expected \"json\"; this build has no generated translators." << endl;
+#endif
+        exit(EXIT_FAILURE);
+    }
+
+    // the scanner has no tree to walk, so log files are always read one event at a time
+    if (engine == "scanner")
+        read_mode = "mmap";
+
+    if (output_format != "text" && output_format != "binary") {
+        cerr << "Unknown output format: " << output_format << ". Expected \"text\" or \"binary\"." << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    sink_spec defaults;
+    defaults.format = output_format == "binary" ? SINK_BINARY : SINK_TEXT;
+    defaults.batch_lines = output_batch_lines;
+    defaults.linger_ms = output_linger_ms;
+    string sink_error;
+    if (!parse_sink_specs(output_list, defaults, sink_specs, sink_error)) {
+        cerr << sink_error << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    // -q 1 also takes standard out off a list given with -o
+    if (!stdout_echo) {
+        sink_specs.erase(remove_if(sink_specs.begin(), sink_specs.end(),
+                                   [](const sink_spec &spec) { return spec.kind == "stdout"; }),
+                         sink_specs.end());
+        if (sink_specs.empty()) {
+            cerr << "No output left: -q 1 takes standard out off " << output_list << "." << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (read_mode != "dom" && read_mode != "mmap") {
+        cerr << "Unknown read mode: " << read_mode << ". Expected \"dom\" or \"mmap\"." << endl;
+        exit(EXIT_FAILURE);
+    }
 
     return xml_logs_path;
 }
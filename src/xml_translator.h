@@ -20,20 +20,33 @@
 #include <cctype> 
 #include <utility>
 #include <regex>
+#include <set>
+#include <string_view>
 #include <sw/redis++/redis++.h>
 
 #include "../lib/pugixml-1.14/pugixml.hpp"
 #include "../lib/json/single_include/nlohmann/json.hpp"
 #include "../lib/libilf/ILF/ILF.h"
+#include "event_splitter.h"
+#include "mapped_file.h"
+#include "sysmon_scanner.h"
+#include "xml_arena.h"
+#include "metrics.h"
+#include "event_plans.h"
+#include "field_translation.h"
+#include "ilf_view.h"
+#include "plan_cache.h"
+#include "plan_reloader.h"
+#include "output_sinks.h"
+#include "segment_sink.h"
+#ifdef GENERATED_TRANSLATORS
+#include "generated_translators.h"
+#endif
 
 using namespace std;
 using namespace pugi;
 using json = nlohmann::json;
 
-#define HASHES "Hashes"
-#define HASH "Hash"
-#define USER "User"
-
 class XML_TO_ILF {
     public:
         XML_TO_ILF(int argc, char *argv[]);
@@ -45,7 +58,12 @@ class XML_TO_ILF {
         int run();
         int run_from_stdin(istream &);
         int run_from_string(string event_string) ;
+        int run_from_buffer(char *event_buffer, size_t length);
         ILF *process_event(xml_node);
+        ILF *process_event(char *event_buffer, size_t length);
+
+        // Waits until the events written so far have left every output
+        void flush_output();
 
         // For testing
         json get_allowed_fields_json() const;
@@ -54,16 +72,32 @@ class XML_TO_ILF {
         
         const xml_document *get_root() const;
         int get_num_events_processed();
+        long long get_metric(const string &name);
         static string replace_periods(string);
         string get_stream_type();
     
     private:
-        // Object holding the XML tree
+        // Object holding the XML tree of a whole event log file (read mode "dom")
         xml_document root;
 
+        // Object holding the XML tree of the current event when events are parsed one at a time.
+        // Its pages come from an arena that is rewound for each event.
+        ARENA_XML_DOCUMENT event_document;
+
         // Whether or not the translator reads from a stream
         string stream_type;
 
+        // How event log files are read: "dom" loads the whole file into one XML tree,
+        // "mmap" maps the file and parses it one event at a time
+        string read_mode = "dom";
+
+        // Engine extracting the event values: "pugixml" builds an XML tree for each event,
+        // "scanner" reads the values straight from the event's bytes
+        string engine = "pugixml";
+
+        // Values of the event being processed, reused across events
+        sysmon_fields event_fields;
+
         // JSON objects to store configuration files data
         json allowed_fields_json, field_mappings_json, event_names_json, redis_json;
         
@@ -81,36 +115,94 @@ class XML_TO_ILF {
         string field_mappings_base_path = "../lib/sysmon_configurations/field-mappings-configs/";
         string redis_config_path        = "../lib/sysmon_configurations/redis/redis_config.json";
 
-        // Counter to track the number of events processed
-        int num_events_processed;
+        // Counters and gauges, reported to cerr every metrics_interval seconds (0: only on exit, -1: never)
+        METRICS metrics;
+        int metrics_interval = -1;
+        metric &xml_arena_high_water = metrics.get("xml_arena_high_water_bytes");
+        metric &xml_arena_capacity = metrics.get("xml_arena_capacity_bytes");
 
-        typedef struct sysmon_xml {
-            string id;
-            string event_name;
-            string sender; 
-            string receiver;
-            string time;
-            vector<key_val> event_data;
-        } sysmon_xml;
+        // Counter to track the number of events processed
+        metric &num_events_processed = metrics.get("events_processed");
+
+        // Translation plan of each event ID, compiled from the configuration files. Replaced as a
+        // whole, between two events, when the configuration files are reloaded (SIGHUP).
+        shared_ptr<const EVENT_PLANS> event_plans;
+        PLAN_RELOADER plan_reloader;
+        metric &plans_version = metrics.get("plans_version");
+        metric &plans_swap_us = metrics.get("plans_swap_us");
+        metric &plans_reload_failures = metrics.get("plans_reload_failures");
+
+        // Where the translation of each event ID comes from: "json" compiles the configuration files
+        // when the program starts, "generated" uses the translators generated from them at build time
+        string translators = "json";
+
+        // File caching the compiled plans between runs (-k), keyed by the contents of the
+        // configuration files. Empty when there is no cache.
+        string plan_cache_path;
+        metric &plan_cache_hit = metrics.get("plan_cache_hit");
+        metric &plans_load_us = metrics.get("plans_load_us");
+
+        // Events are dropped when their ID has no event name or is on the deny list (-d), before
+        // they are parsed whenever the ID can be read from the raw bytes
+        set<string, less<>> denied_event_ids;
+        metric &num_events_unconfigured = metrics.get("events_dropped_unconfigured");
+        metric &num_events_denied = metrics.get("events_dropped_denied");
+
+        // Translation of the event being processed, reused across events. It points into the
+        // event and the plans, so no string is copied before the event is rendered.
+        ILF_VIEW event_view;
+
+        // Text of the event being written, rendered once for every output and reused across events
+        string ilf_text;
+
+        // Outputs of the events (-o), "stdout,redis" by default. -q 1 takes standard out off the
+        // list, given or default, e.g. when Redis is the only output that matters. The lines of the stream
+        // sinks are batched by default in batches of output_batch_lines (-b), written once the first
+        // line of a batch has waited output_linger_ms (-g).
+        string output_list;
+        bool stdout_echo = true;
+        vector<sink_spec> sink_specs;
+        vector<unique_ptr<OUTPUT_SINK>> sinks;
+
+        // Default format of the sinks (-w): "text" (ILF lines) or "binary", the encoding of
+        // ILF_binary.h whose dictionary starts with the keys and event names of the plans. The
+        // binary frames are rendered once for all the sinks taking them.
+        string output_format = "text";
+        bool binary_output = false;
+        ILF_ENCODER ilf_encoder;
+        string ilf_binary;
+        size_t output_batch_lines = LINE_WRITER_BATCH_LINES;
+        int output_linger_ms = LINE_WRITER_LINGER_MS;
 
         sw::redis::ConnectionOptions redis_connection_options;
-        sw::redis::Redis *redis;
+        sw::redis::Redis *redis = nullptr;
         string redis_channel;
+        string redis_stream;            // key of the stream of the redis_stream sink, if configured
+        bool uses_redis() const;
+        void open_sinks();
+        void stop_sinks();
         void setup_redis();
         
         void import_configs();
         void import_config(string, json &);
+        static string read_config(const string &);
+        static bool parse_config(const string &, const string &, json &);
+        void compile_event_plans();
+        shared_ptr<const EVENT_PLANS> load_event_plans();
+        shared_ptr<const EVENT_PLANS> reload_event_plans();
+        void take_reloaded_plans();
+        bool drop_event(const event_plan &);
         void load_event_file(string xml_logs_path);
-        void get_event_data(xml_node, map<string, string> *);
-        bool get_event_metadata(sysmon_xml *, xml_node) ;
-        void get_field_values(sysmon_xml *, map<string, string> *);
-        void get_1_many_fields(map<string, pair<string, string>> *, string);
-        void parse_XML_hashes(stringstream &, map<string, pair<string, string>> &, sysmon_xml *);
-        void parse_XML_user(stringstream &, map<string, pair<string, string>> &, sysmon_xml *);
+        int run_from_mapped_file();
+        int run_from_events(istream &);
+        bool scan_event(char *event_buffer, size_t length);
+        bool translate_event(const sysmon_fields &);
+        void write_event(string_view terminator);
+        void begin_binary_output();
+        void get_event_fields(xml_node, sysmon_fields &);
+        void get_event_metadata(ILF_VIEW &, const event_plan &, const sysmon_fields &);
         string parse_args(int argc, char *argv[]);
         bool parse_arg(int, char *[], const string &, string &);
-        bool isNumber(const string&);
-        string quote_string(string, bool isHash = false);
 };
 
 
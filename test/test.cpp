@@ -6,9 +6,18 @@
 */
 
 #include <assert.h>
+#include <dirent.h>
 #include <regex>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 #include "../src/xml_translator.h"
+#include "../src/scan_kernels.h"
+#include "../src/ring_sink.h"
+#include "../lib/libilf/ILF/ILF_parser.h"
+#include "../lib/libilf/ILF/ILF_ring.h"
 /*
     Usage: 
         1) ./test
@@ -37,6 +46,26 @@ void test_configs(string id);
 void test_values(string id);
 void test_streaming_cin();
 void test_streaming_filestream();
+void test_streaming_multiline();
+void test_event_splitter();
+void test_mapped_file_mode();
+void test_scanner_engine();
+void test_scan_kernels();
+void test_xml_arena();
+void test_event_id_filter();
+void test_field_projection();
+void test_event_plans();
+void test_field_translation();
+void test_plan_cache();
+void test_plan_reloader();
+void test_ilf_text();
+void test_line_writer();
+void test_ilf_binary();
+void test_ilf_parser();
+void test_output_sinks();
+void test_segment_sink();
+void test_ring_sink();
+void test_generated_translators();
 void one_to_many_mappings(string event_id);
 void assert_key(vector<key_val> attributes, string keym, bool negate = false);
 void assert_key_val(vector<key_val> attributes, string key, string value, bool negate = false);
@@ -69,6 +98,26 @@ int main (int argc, char *argv[])
     // test_streaming_cin();
 
     test_streaming_filestream();
+    test_streaming_multiline();
+    test_event_splitter();
+    test_mapped_file_mode();
+    test_scanner_engine();
+    test_scan_kernels();
+    test_xml_arena();
+    test_event_id_filter();
+    test_field_projection();
+    test_event_plans();
+    test_field_translation();
+    test_plan_cache();
+    test_plan_reloader();
+    test_ilf_text();
+    test_line_writer();
+    test_ilf_binary();
+    test_ilf_parser();
+    test_output_sinks();
+    test_segment_sink();
+    test_ring_sink();
+    test_generated_translators();
 
     cout << "All tests passed!" << endl;
     return 0;
@@ -114,6 +163,56 @@ void test_streaming_filestream()
     assert(translator.run_from_stdin(my_input_file) == 0);
 }
 
+// from a filestream holding a whole <Events> document, with several events per line
+void test_streaming_multiline()
+{
+    cout << "test_streaming_multiline()" << endl << endl;
+    string s = "stdin";
+    char *mock_cli[] = { (char *) "./main", 
+                            (char *) "-m", 
+                            (char *) field_mappings.c_str(), 
+                            (char *) "-f", 
+                            (char *) allowed_fields.c_str(), 
+                            (char *) "-e", 
+                            (char *) event_names.c_str(), 
+                            (char *) "-l", 
+                            (char *) s.c_str() };
+    
+    XML_TO_ILF translator = XML_TO_ILF(9, mock_cli);
+   
+    ifstream my_input_file;
+    my_input_file.open("./input-logs/five_events.xml");
+    
+    assert(translator.run_from_stdin(my_input_file) == 0);
+    assert(translator.get_num_events_processed() == 5);
+}
+
+// Checks that events are split on their tags, not on lines, even when tags straddle chunk edges.
+void test_event_splitter()
+{
+    cout << "test_event_splitter()" << endl << endl;
+    string event = "<Event xmlns='http://schemas.microsoft.com/win/2004/08/events/event'>\n"
+                   "  <System>\n    <EventID>1</EventID>\n    <EventRecordID>7</EventRecordID>\n  </System>\n"
+                   "  <EventData>\n    <Data Name='User'>A\\B</Data>\n  </EventData>\n"
+                   "</Event>";
+    string input = "<?xml version=\"1.0\"?>\n<Events>\n" + event + event + "\n" + event + "\n</Events>\n";
+
+    // a tiny chunk size forces tags to be split across reads
+    for (size_t chunk_size : { 3, 7, 64, 4096 }) {
+        istringstream stream(input);
+        EVENT_SPLITTER splitter(stream, chunk_size);
+
+        char *e;
+        size_t length;
+        int count = 0;
+        while (splitter.next_event(e, length)) {
+            assert(string(e, length) == event);
+            count++;
+        }
+        assert(count == 3);
+    }
+}
+
 // Reads in the entirety of each configuration file into JSON objects,
 // and extracts and stores the data relevant to the given event under test.
 void setup_event(string id, json &sub_allowed_fields, json &sub_event_names, json &sub_field_mappings, string &xml_logs_path)
@@ -275,6 +374,121 @@ void five_events_test()
     assert(translator.get_num_events_processed() == 5);
 }
 
+// Checks that all 5 events in the XML file are processed when the file is memory-mapped
+// and parsed one event at a time
+void test_mapped_file_mode()
+{   
+    cout << "test_mapped_file_mode()" << endl << endl;
+    string s = "./input-logs/five_events.xml";
+
+    char *mock_cli[] = { (char *) "./main", 
+                            (char *) "-m", 
+                            (char *) field_mappings.c_str(), 
+                            (char *) "-f", 
+                            (char *) allowed_fields.c_str(), 
+                            (char *) "-e", 
+                            (char *) event_names.c_str(), 
+                            (char *) "-l", 
+                            (char *) s.c_str(),
+                            (char *) "-r",
+                            (char *) "mmap" };
+    
+    XML_TO_ILF translator = XML_TO_ILF(11, mock_cli);
+    assert(translator.run() == 0);
+    assert(translator.get_num_events_processed() == 5);
+}
+
+// Checks that the scanner engine produces the same ILF as the pugixml engine for every event
+// in the input logs, including the ones that are dropped.
+void test_scanner_engine()
+{
+    cout << "test_scanner_engine()" << endl << endl;
+    string s = "stdin";
+    char *mock_cli[] = { (char *) "./main", 
+                            (char *) "-m", 
+                            (char *) field_mappings.c_str(), 
+                            (char *) "-f", 
+                            (char *) allowed_fields.c_str(), 
+                            (char *) "-e", 
+                            (char *) event_names.c_str(), 
+                            (char *) "-l", 
+                            (char *) s.c_str() };
+    
+    XML_TO_ILF translator = XML_TO_ILF(9, mock_cli);
+
+    vector<string> files = { "five_events.xml", "streaming.xml" };
+    for (int i = 1; i <= 24; i++)
+        files.push_back(to_string(i) + ".xml");
+    files.push_back("255.xml");
+
+    int num_compared = 0;
+    for (string file : files) {
+        ifstream input(input_base_path + file, ios::binary);
+        string contents((istreambuf_iterator<char>(input)), istreambuf_iterator<char>());
+
+        const char *p = contents.data(), *end = p + contents.size();
+        while (true) {
+            const char *open = find_event_open(p, end);
+            if (open == end)
+                break;
+            p = find_event_close(open, end) + EVENT_CLOSE_TAG_LEN;
+
+            // both engines modify the buffer, so each gets its own copy
+            string dom_event(open, p), scanned_event(open, p);
+
+            xml_document doc;
+            assert(doc.load_buffer_inplace(&dom_event[0], dom_event.size()));
+            ILF *expected = translator.process_event(doc.first_child());
+            ILF *actual   = translator.process_event(&scanned_event[0], scanned_event.size());
+
+            assert((expected == nullptr) == (actual == nullptr));
+            if (expected != nullptr)
+                assert(expected->to_string() == actual->to_string());
+
+            delete expected;
+            delete actual;
+            num_compared++;
+        }
+    }
+    assert(num_compared > 0);
+}
+
+// Checks that every supported vector kernel finds the same matches as the scalar one,
+// including matches that straddle or end exactly at a register boundary.
+void test_scan_kernels()
+{
+    cout << "test_scan_kernels()" << endl << endl;
+    scan_kernel best = get_scan_kernel();
+
+    string haystack;
+    for (int i = 0; i < 300; i++)
+        haystack += string(i % 37, 'x') + (i % 3 ? "<Data Name=" : "</Event") + (i % 5 ? ">" : "<");
+    
+    vector<string> needles = { "<Data Name=", EVENT_CLOSE_TAG, "<", "<D", "xx<", "not there" };
+    for (string needle : needles) {
+        for (size_t start = 0; start < 64; start++) {
+            for (size_t trim = 0; trim < 64; trim += 7) {
+                const char *begin = haystack.data() + start, *end = haystack.data() + haystack.size() - trim;
+
+                set_scan_kernel(SCAN_SCALAR);
+                vector<const char *> expected;
+                for (const char *p = begin; (p = find_substring(p, end, needle.data(), needle.size())) != end; p++)
+                    expected.push_back(p);
+
+                for (scan_kernel kernel : { SCAN_SSE2, SCAN_AVX2 }) {
+                    if (!set_scan_kernel(kernel))
+                        continue;
+                    vector<const char *> actual;
+                    for (const char *p = begin; (p = find_substring(p, end, needle.data(), needle.size())) != end; p++)
+                        actual.push_back(p);
+                    assert(actual == expected);
+                }
+            }
+        }
+    }
+    set_scan_kernel(best);
+}
+
 // asserts that a given key does or does not exist in the ILF's list of attributes.
 void assert_key(vector<key_val> attributes, string key, bool negate /*= false*/)
 {   
@@ -355,4 +569,1329 @@ void one_to_many_mappings(string event_id)
     // the event does not contain an entry for sha1, so assert that it's not in the ILF.
     bool negate = true;
     assert_key(attributes, "process__hash__sha1", negate);
-}
\ No newline at end of file
+}
+// the arena hands out aligned memory, reuses its blocks after a rewind, and keeps
+// documents parsed one event at a time from growing it
+void test_xml_arena()
+{
+    cout << "test_xml_arena()" << endl << endl;
+
+    XML_ARENA arena(1024);
+    char *first = (char *) arena.allocate(100);
+    char *second = (char *) arena.allocate(100);
+    assert((size_t) first % alignof(max_align_t) == 0 && (size_t) second % alignof(max_align_t) == 0);
+    assert(second >= first + 100);
+    assert(arena.owns(first) && arena.owns(second));
+
+    // larger than a block: gets a block of its own
+    char *large = (char *) arena.allocate(4096);
+    assert(arena.owns(large + 4095));
+    assert(arena.get_capacity() == 1024 + 4096);
+
+    int on_heap;
+    assert(!arena.owns(&on_heap));
+
+    size_t high_water = arena.get_high_water();
+    arena.rewind();
+    assert(arena.allocate(100) == first);
+    assert(arena.get_high_water() == high_water);
+    assert(arena.get_capacity() == 1024 + 4096);
+
+    ifstream input(input_base_path + "five_events.xml", ios::binary);
+    string contents((istreambuf_iterator<char>(input)), istreambuf_iterator<char>());
+
+    // a document outside the arena, allocated and freed with malloc while the arena is installed
+    xml_document heap_doc;
+    assert(heap_doc.load_string(contents.c_str()));
+
+    ARENA_XML_DOCUMENT doc;
+    size_t capacity = 0;
+    for (int pass = 0; pass < 3; pass++) {
+        const char *p = contents.data(), *end = p + contents.size();
+        while ((p = find_event_open(p, end)) != end) {
+            const char *close = find_event_close(p, end) + EVENT_CLOSE_TAG_LEN;
+            string event(p, close);
+            p = close;
+
+            assert(doc.load_buffer_inplace(&event[0], event.size()));
+            assert(string(doc.first_child().name()) == "Event");
+            assert(string(doc.first_child().child("System").child("EventID").text().get()) != "");
+            assert(doc.get_arena().get_high_water() <= doc.get_arena().get_capacity());
+
+            // capacity is settled by the first pass
+            if (pass == 0)
+                capacity = doc.get_arena().get_capacity();
+            else
+                assert(doc.get_arena().get_capacity() == capacity);
+        }
+    }
+    assert(capacity > 0);
+    assert(heap_doc.child("Events").first_child());
+
+    cout << "* * * * " << endl;
+}
+
+// events are dropped and counted, without being parsed when possible, if their
+// ID has no event name or is on the deny list
+void test_event_id_filter()
+{
+    cout << "test_event_id_filter()" << endl << endl;
+
+    string_view id;
+    string event = "<Event><System><EventID>22</EventID></System></Event>";
+    assert(peek_event_id(event.data(), event.size(), id) && id == "22");
+
+    event = "<Event><System><EventID Qualifiers=''> 7</EventID></System></Event>";
+    assert(peek_event_id(event.data(), event.size(), id) && id == " 7");
+
+    // the parsed value could differ from the raw text
+    for (string unsure : { "<Event><System><EventID>&#49;</EventID></System></Event>",
+                           "<Event><System><EventID><![CDATA[1]]></EventID></System></Event>",
+                           "<Event><System><EventID>1<!-- -->1</EventID></System></Event>",
+                           "<Event><System><EventID/></System></Event>",
+                           "<Event><System><EventIDs>1</EventIDs></System></Event>",
+                           "<Event><System><EventID>1" })
+        assert(!peek_event_id(unsure.data(), unsure.size(), id));
+
+    string s = "stdin";
+    char *mock_cli[] = { (char *) "./main", 
+                            (char *) "-m", 
+                            (char *) field_mappings.c_str(), 
+                            (char *) "-f", 
+                            (char *) allowed_fields.c_str(), 
+                            (char *) "-e", 
+                            (char *) event_names.c_str(), 
+                            (char *) "-l", 
+                            (char *) s.c_str(),
+                            (char *) "-d",
+                            (char *) "3,22",
+                            (char *) "-p",
+                            (char *) "pugixml" };
+
+    for (string engine : { "pugixml", "scanner" }) {
+        mock_cli[12] = (char *) engine.c_str();
+        XML_TO_ILF translator = XML_TO_ILF(13, mock_cli);
+
+        ifstream input(input_base_path + "five_events.xml", ios::binary);
+        string contents((istreambuf_iterator<char>(input)), istreambuf_iterator<char>());
+        const char *p = contents.data(), *end = p + contents.size();
+        while ((p = find_event_open(p, end)) != end) {
+            const char *close = find_event_close(p, end) + EVENT_CLOSE_TAG_LEN;
+            string event(p, close);
+            p = close;
+
+            translator.run_from_string(event);
+
+            // an unconfigured ID, both raw and behind an entity so that the event has to be parsed
+            size_t at = event.find("<EventID>") + 9;
+            string unconfigured = event;
+            unconfigured.replace(at, event.find('<', at) - at, "9999");
+            translator.run_from_string(unconfigured);
+            unconfigured.replace(at, 4, "&#57;999");
+            translator.run_from_string(unconfigured);
+        }
+
+        assert(translator.get_num_events_processed() == 3);
+        assert(translator.get_metric("events_dropped_denied") == 2);
+        assert(translator.get_metric("events_dropped_unconfigured") == 10);
+    }
+
+    cout << "* * * * " << endl;
+}
+
+// the scanner only extracts, and decodes, the Data fields the plan of the event's ID uses
+void test_field_projection()
+{
+    cout << "test_field_projection()" << endl << endl;
+
+    string event = "<Event><System><EventID>1</EventID></System><EventData>"
+                   "<Data Name='Image'>C:\\a&amp;b.exe</Data>"
+                   "<Data Name='CommandLine'>a &amp; b</Data>"
+                   "<Data Name='User'>DOMAIN\\user</Data>"
+                   "<Data Name='User'>second</Data>"
+                   "</EventData></Event>";
+
+    EVENT_PLANS plans;
+    event_plan &plan = plans.add("1");
+    plan.disposition = EVENT_TRANSLATED;
+    plan.fields.push_back({ "Image", -1, SPLIT_NONE, QUOTE_UNLESS_NUMBER, "process__executable", {} });
+    plan.fields.push_back({ "User", -1, SPLIT_USER, QUOTE_UNLESS_NUMBER, "", {} });
+    plans.add("2").disposition = EVENT_TRANSLATED;
+    plans.assign_slots();
+
+    int image = plans.find_slot(plans.find("1"), "Image");
+    int user  = plans.find_slot(plans.find("1"), "User");
+    assert(image >= 0 && user >= 0 && image != user);
+    assert(plans.find_slot(plans.find("1"), "CommandLine") == -1);
+    assert(plans.find_slot(plans.find("2"), "Image") == -1);
+
+    string projected = event;
+    sysmon_fields fields;
+    assert(scan_sysmon_event(&projected[0], projected.size(), fields, &plans));
+    assert(fields.projected && fields.data.empty());
+    assert(fields.has_value(image) && fields.values[image] == "C:\\a&b.exe");
+    assert(fields.has_value(user) && fields.values[user] == "DOMAIN\\user");
+
+    // skipped values are left as they are in the buffer
+    assert(projected.find("a &amp; b") != string::npos);
+
+    // an ID with a plan that uses none of the fields
+    string other = event;
+    other.replace(other.find(">1<") + 1, 1, "2");
+    assert(scan_sysmon_event(&other[0], other.size(), fields, &plans));
+    assert(fields.projected && !fields.has_value(image) && !fields.has_value(user));
+
+    // without plans, every field is kept in document order
+    string unprojected = event;
+    assert(scan_sysmon_event(&unprojected[0], unprojected.size(), fields));
+    assert(!fields.projected && fields.data.size() == 4);
+    assert(fields.data[1].second == "a & b");
+
+    cout << "* * * * " << endl;
+}
+
+// plans are found by ID, through the table for small decimal IDs and the map for the rest
+void test_event_plans()
+{
+    cout << "test_event_plans()" << endl << endl;
+
+    EVENT_PLANS plans;
+    for (string id : { "7", "07", "255", "256", "x" }) {
+        event_plan &plan = plans.add(id);
+        plan.disposition = EVENT_TRANSLATED;
+        plan.event_name = "name" + id;
+        plan.fields.push_back({ "Field" + id, -1, SPLIT_NONE, QUOTE_UNLESS_NUMBER, "key", {} });
+    }
+    plans.assign_slots();
+
+    for (string id : { "7", "07", "255", "256", "x" }) {
+        const event_plan &plan = plans.find(id);
+        assert(plan.disposition == EVENT_TRANSLATED);
+        assert(plan.id == id && plan.event_name == "name" + id);
+        assert(plans.find_slot(plan, "Field" + id) == plan.fields[0].slot);
+    }
+    for (string id : { "", "0", "8", "007", "7 ", "-7", "1000" })
+        assert(plans.find(id).disposition == EVENT_UNCONFIGURED);
+    assert(plans.get_slot_count() == 5);
+
+    plans.clear();
+    assert(plans.find("7").disposition == EVENT_UNCONFIGURED);
+    assert(plans.find("x").disposition == EVENT_UNCONFIGURED);
+
+    // every known name gets its own slot, and anything else misses
+    vector<string> names;
+    for (int i = 0; i < 500; i++)
+        names.push_back("Field" + to_string(i));
+    names.push_back("Field0");
+    FIELD_SLOTS slots;
+    slots.build(names);
+    assert(slots.size() == 500);
+    for (int i = 0; i < 500; i++) {
+        assert(slots.find("Field" + to_string(i)) == i);
+        assert(slots.get_name(i) == names[i]);
+    }
+    for (string unknown : { "", "Field", "Field500", "field0", "Field0 " })
+        assert(slots.find(unknown) == -1);
+
+    cout << "* * * * " << endl;
+}
+
+// the helpers shared by the plans and the generated translators, and rebuilding the plans of
+// generated translators
+void test_field_translation()
+{
+    cout << "test_field_translation()" << endl << endl;
+
+    for (string value : { "", "0", "12.5", "0x1F", "0xnot hex", "-1", "a\\b", "say \"hi\"", "1 2" }) {
+        string unless_number, always, never;
+        append_value(unless_number, value, QUOTE_UNLESS_NUMBER);
+        append_value(always, value, QUOTE_ALWAYS);
+        append_value(never, value, QUOTE_NEVER);
+
+        ostringstream quoted_value;
+        quoted_value << quoted(value);
+        bool number = value.rfind("0x", 0) == 0 || value.find_first_not_of("0123456789.") == string::npos;
+        assert(unless_number == (number ? value : quoted_value.str()));
+        assert(always == quoted_value.str());
+        assert(never == value);
+    }
+
+    string_view hash;
+    assert(find_hash("MD5=AB,SHA256=CD", "md5", hash) && hash == "AB");
+    assert(find_hash("md5=1,MD5=2", "md5", hash) && hash == "2");
+    assert(!find_hash("md5=1,md5=", "md5", hash));
+    assert(!find_hash("md5", "md5", hash));
+    assert(!find_hash("SHA1=AB", "md5", hash));
+    assert(find_hash("md5=AB\nrest,x=y", "md5", hash) && hash == "AB");
+
+    // one pass finds every type, in the order asked for
+    string_view types[] = { "imphash", "md5", "sha1" }, hashes[3];
+    split_hashes("SHA1=A,MD5=B,IMPHASH=,md5=C", types, 3, hashes);
+    assert(hashes[0].empty() && hashes[1] == "C" && hashes[2] == "A");
+
+    string_view domain, name;
+    assert(split_user("DOMAIN\\user", domain, name) && domain == "DOMAIN" && name == "user");
+    assert(split_user("user", domain, name) && domain == "user" && name.empty());
+    assert(split_user("D\\a\\b\nc", domain, name) && domain == "D" && name == "a\\b");
+    assert(!split_user("-", domain, name));
+
+    // splitters are compiled into the part each subfield takes
+    field_plan user = { "User", -1, SPLIT_USER, QUOTE_UNLESS_NUMBER, "", { { "domain", "user__domain", -1 }, { "id", "user__id", -1 }, { "name", "user__name", -1 } } };
+    EVENT_PLANS::assign_parts(user);
+    assert(user.subfields[0].part == USER_DOMAIN && user.subfields[1].part == -1 && user.subfields[2].part == USER_NAME);
+    user.subfields.pop_back();
+    EVENT_PLANS::assign_parts(user);
+    assert(user.subfields[0].part == -1 && user.subfields[1].part == -1);
+
+    // the plans of generated translators have to come out with the slots they were generated with
+    EVENT_PLANS plans;
+    json names = { { "1", "ProcessCreate" }, { "x", "Other" } };
+    json allowed = { { "1", { "Image", "Hashes" } }, { "x", { "Image" } } };
+    json mappings = { { "1", { { "Image", "process.executable" }, { "Hashes", { "process.hash.md5" } } } },
+                      { "x", { { "Image", "file.path" } } } };
+    plans.compile(names, allowed, mappings, {});
+
+    vector<generated_event> events;
+    vector<vector<string_view>> sources;
+    for (const event_plan *plan : plans.get_plans()) {
+        sources.push_back({});
+        for (const field_plan &field : plan->fields)
+            sources.back().push_back(field.source);
+    }
+    vector<const event_plan *> compiled = plans.get_plans();
+    for (size_t i = 0; i < compiled.size(); i++)
+        events.push_back({ compiled[i]->id, compiled[i]->event_name, sources[i].data(), sources[i].size() });
+    vector<string_view> slot_names = { "Image", "Hashes" };
+
+    EVENT_PLANS generated_plans;
+    assert(generated_plans.load_generated(events.data(), events.size(), slot_names.data(), slot_names.size()));
+    assert(generated_plans.find("1").event_name == "ProcessCreate");
+    assert(generated_plans.find_slot(generated_plans.find("1"), "Hashes") == 1);
+    assert(generated_plans.find_slot(generated_plans.find("x"), "Hashes") == -1);
+
+    swap(slot_names[0], slot_names[1]);
+    assert(!generated_plans.load_generated(events.data(), events.size(), slot_names.data(), slot_names.size()));
+
+    cout << "* * * * " << endl;
+}
+
+// plans saved to the cache come back the same under the same key, and nothing else loads
+void test_plan_cache()
+{
+    cout << "test_plan_cache()" << endl << endl;
+
+    json names = { { "1", "ProcessCreate" }, { "x", "Other" } };
+    json allowed = { { "1", { "Image", "User", "Hashes" } }, { "x", { "Image" } } };
+    json mappings = { { "1", { { "Image", "process.executable" }, { "User", { "user.domain", "user.name" } },
+                               { "Hashes", { "process.hash.sha256", "process.hash.md5" } } } },
+                      { "x", { { "Image", "file.path" } } } };
+    EVENT_PLANS plans;
+    plans.compile(names, allowed, mappings, {});
+
+    string path = "plan_cache_test.bin";
+    uint64_t key = PLAN_CACHE::content_key({ allowed.dump(), mappings.dump(), names.dump() });
+    assert(key != PLAN_CACHE::content_key({ allowed.dump(), names.dump(), mappings.dump() }));
+    assert(PLAN_CACHE::save(path, key, plans));
+
+    EVENT_PLANS cached;
+    assert(PLAN_CACHE::load(path, key, cached));
+    assert(cached.get_plans().size() == plans.get_plans().size());
+    for (const event_plan *plan : plans.get_plans()) {
+        const event_plan &cached_plan = cached.find(plan->id);
+        assert(cached_plan.event_name == plan->event_name && cached_plan.disposition == plan->disposition);
+        assert(cached_plan.fields.size() == plan->fields.size());
+        for (size_t i = 0; i < plan->fields.size(); i++) {
+            const field_plan &a = plan->fields[i], &b = cached_plan.fields[i];
+            assert(a.source == b.source && a.slot == b.slot && a.split == b.split && a.quoting == b.quoting && a.key == b.key);
+            assert(a.subfields.size() == b.subfields.size());
+            for (size_t j = 0; j < a.subfields.size(); j++)
+                assert(a.subfields[j].name == b.subfields[j].name && a.subfields[j].key == b.subfields[j].key);
+        }
+    }
+
+    // another key, a damaged file and a missing one all miss
+    assert(!PLAN_CACHE::load(path, key + 1, cached));
+    assert(cached.find("1").disposition == EVENT_UNCONFIGURED);
+
+    string contents;
+    {
+        ifstream file(path, ios::binary);
+        contents.assign((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    }
+    for (size_t damaged : { contents.size() / 2, contents.size() - 1 }) {
+        ofstream file(path, ios::binary | ios::trunc);
+        string copy = contents;
+        copy[damaged] ^= 1;
+        file << copy;
+        file.close();
+        assert(!PLAN_CACHE::load(path, key, cached));
+    }
+    {
+        ofstream file(path, ios::binary | ios::trunc);
+        file << contents.substr(0, contents.size() - 1);
+    }
+    assert(!PLAN_CACHE::load(path, key, cached));
+
+    remove(path.c_str());
+    assert(!PLAN_CACHE::load(path, key, cached));
+
+    cout << "* * * * " << endl;
+}
+
+void test_plan_reloader()
+{
+    cout << "test_plan_reloader()" << endl << endl;
+
+    // a configuration with the wrong types fails to compile instead of exiting
+    EVENT_PLANS bad;
+    assert(!bad.compile({ { "1", 5 } }, json::object(), json::object(), {}));
+    assert(bad.find("1").disposition == EVENT_UNCONFIGURED);
+
+    atomic<int> builds(0);
+    atomic<bool> fail(false);
+    PLAN_RELOADER reloader;
+    reloader.start([&]() -> shared_ptr<const EVENT_PLANS> {
+        builds++;
+        if (fail)
+            return nullptr;
+        shared_ptr<EVENT_PLANS> plans = make_shared<EVENT_PLANS>();
+        plans->add("1").event_name = "Version" + to_string(builds);
+        return plans;
+    });
+
+    shared_ptr<const EVENT_PLANS> plans = make_shared<EVENT_PLANS>();
+    shared_ptr<const EVENT_PLANS> in_flight = plans;
+    chrono::microseconds waited;
+    assert(!reloader.take(plans, waited));
+
+    // nothing is swapped in until the plans are taken, and holders of the old plans keep them
+    PLAN_RELOADER::request_reload();
+    for (int i = 0; i < 100 && !reloader.take(plans, waited); i++)
+        this_thread::sleep_for(chrono::milliseconds(PLAN_RELOADER_POLL_MS / 2));
+    assert(plans->find("1").event_name == "Version1" && in_flight->find("1").event_name == "");
+    assert(waited.count() >= 0 && !reloader.take(plans, waited));
+
+    // a failed build publishes nothing
+    fail = true;
+    PLAN_RELOADER::request_reload();
+    for (int i = 0; i < 100 && builds < 2; i++)
+        this_thread::sleep_for(chrono::milliseconds(PLAN_RELOADER_POLL_MS / 2));
+    this_thread::sleep_for(chrono::milliseconds(PLAN_RELOADER_POLL_MS));
+    assert(builds == 2 && !reloader.take(plans, waited));
+    assert(plans->find("1").event_name == "Version1");
+    reloader.stop();
+
+#ifdef SIGHUP
+    // SIGHUP reloads the translator's configuration files; the new plans are used from the next event
+    string s = "stdin";
+    char *mock_cli[] = { (char *) "./main", 
+                            (char *) "-m", 
+                            (char *) field_mappings.c_str(), 
+                            (char *) "-f", 
+                            (char *) allowed_fields.c_str(), 
+                            (char *) "-e", 
+                            (char *) event_names.c_str(), 
+                            (char *) "-l", 
+                            (char *) s.c_str(),
+                            (char *) "-d",
+                            (char *) "3" };
+    XML_TO_ILF translator = XML_TO_ILF(11, mock_cli);
+    assert(translator.get_metric("plans_version") == 1);
+
+    // a denied event is dropped before anything is written
+    string denied = "<Event><System><EventID>3</EventID></System></Event>";
+    raise(SIGHUP);
+    for (int i = 0; i < 100 && translator.get_metric("plans_version") == 1; i++) {
+        this_thread::sleep_for(chrono::milliseconds(PLAN_RELOADER_POLL_MS / 2));
+        translator.run_from_string(denied);
+    }
+    assert(translator.get_metric("plans_version") == 2);
+    assert(translator.get_metric("plans_reload_failures") == 0);
+    assert(translator.get_metric("events_dropped_denied") > 0);
+#endif
+
+    cout << "* * * * " << endl;
+}
+
+void test_ilf_text()
+{
+    cout << "test_ilf_text()" << endl << endl;
+
+    ILF empty("Type", "host", "*", "t", {});
+    assert(empty.to_string() == "Type[host,*,t,()] ");
+    assert(empty.text_size() == empty.to_string().size());
+
+    ILF ilf("Type", "host", "*", "t", { key_val("a", "1"), key_val("b", "\"x;y\"") });
+    assert(ilf.to_string() == "Type[host,*,t,(a=1;b=\"x;y\")] ");
+    assert(ilf.text_size() == ilf.to_string().size());
+
+    // appending keeps what the buffer already holds
+    string text = "previous";
+    text.clear();
+    ilf.append_to(text);
+    assert(text == ilf.to_string());
+    empty.append_to(text);
+    assert(text == ilf.to_string() + empty.to_string());
+
+    // a view renders the same text as the ILF it converts to, quoting its values as it goes
+    ILF_VIEW view;
+    view.event_type = "Type";
+    view.sender = "host";
+    view.receiver = "*";
+    view.time = "t";
+    view.attributes = { { "a", "1", QUOTE_NEVER }, { "b", "x\"y", QUOTE_UNLESS_NUMBER }, { "c", "2", QUOTE_ALWAYS } };
+    text.clear();
+    view.append_to(text);
+    assert(text == "Type[host,*,t,(a=1;b=\"x\\\"y\";c=\"2\")] ");
+    assert(view.to_ilf().to_string() == text);
+
+    // the strings and pairs a pmr_ILF holds take their memory from its resource. The copies
+    // get_event() and get_key_vals() return, and the text of to_string(), use the default one.
+    char buffer[4096];
+    pmr::monotonic_buffer_resource batch(buffer, sizeof(buffer), pmr::null_memory_resource());
+    pmr_ILF pmr_ilf = view.to_ilf(pmr::polymorphic_allocator<char>(&batch));
+    assert(pmr_ilf.to_string() == text);
+    assert(pmr_ilf.get_event() == "Type");
+    assert(pmr_ilf.get_event_type().get_allocator().resource() == &batch);
+    assert(pmr_ilf.get_sender().get_allocator().resource() == &batch);
+    assert(pmr_ilf.get_time().get_allocator().resource() == &batch);
+    assert(pmr_ilf.get_pairs().get_allocator().resource() == &batch);
+    for (const pmr_key_val &pair : pmr_ilf.get_pairs())
+        assert(pair.key.get_allocator().resource() == &batch && pair.value.get_allocator().resource() == &batch);
+    pmr::vector<pmr_key_val> batch_pairs(&batch);
+    batch_pairs.push_back(pmr_ilf.get_key_vals()[1]);
+    assert(batch_pairs[0].key == "b" && batch_pairs[0].value == "\"x\\\"y\"");
+    assert(batch_pairs[0].key.get_allocator().resource() == &batch);
+
+    view.clear();
+    assert(view.attributes.empty() && view.to_ilf().to_string() == "[,,,()] ");
+
+    cout << "* * * * " << endl;
+}
+
+// Reads back what a writer wrote to the file
+static string read_output(const string &path)
+{
+    ifstream file(path, ios::binary);
+    return string((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+}
+
+void test_line_writer()
+{
+    cout << "test_line_writer()" << endl << endl;
+
+    string path = "line_writer_test.txt";
+    FILE *file = fopen(path.c_str(), "wb");
+    assert(file != nullptr);
+
+    // lines wait for their batch to fill, and flush() writes them in one go
+    metric writes(0);
+    {
+        LINE_WRITER writer(writes);
+        writer.start(fileno(file), 3, 60000);
+        writer.write("a", "\n");
+        writer.write("b", "\n\n");
+        assert(read_output(path).empty());
+        writer.flush();
+        assert(read_output(path) == "a\nb\n\n" && writes == 1);
+
+        // full batches are written without flushing, in order
+        string expected = "a\nb\n\n";
+        for (int i = 0; i < 1000; i++) {
+            writer.write(to_string(i), "\n");
+            expected += to_string(i) + "\n";
+        }
+        writer.flush();
+        assert(read_output(path) == expected);
+        assert(writes > 1 && writes <= 1 + 334);
+
+        // stop() writes what is left
+        writer.write("last", "\n");
+        writer.stop();
+        assert(read_output(path) == expected + "last\n");
+
+        // and nothing is written after it
+        writer.write("dropped", "\n");
+        writer.flush();
+        assert(read_output(path) == expected + "last\n");
+    }
+
+    // a line that lingers is written without a full batch or a flush
+    {
+        LINE_WRITER writer(writes);
+        writer.start(fileno(file), 100, 5);
+        writer.write("lingered", "\n");
+        for (int i = 0; i < 200 && read_output(path).find("lingered") == string::npos; i++)
+            this_thread::sleep_for(chrono::milliseconds(5));
+        assert(read_output(path).find("lingered\n") != string::npos);
+    }
+
+    fclose(file);
+    remove(path.c_str());
+
+    cout << "* * * * " << endl;
+}
+
+// Decodes a whole stream, checking that each event comes back as the text of the ILF it was
+// encoded from, both as an ILF and as text
+static void assert_round_trip(const string &stream, vector<ILF> &expected)
+{
+    ILF_DECODER decoder, text_decoder;
+    string_view in = stream, text_in = stream;
+    ILF decoded;
+    string text;
+    for (ILF &ilf : expected) {
+        assert(decoder.next(in, decoded));
+        assert(decoded.to_string() == ilf.to_string());
+        text.clear();
+        assert(text_decoder.next_text(text_in, text));
+        assert(text == ilf.to_string());
+    }
+    assert(!decoder.next(in, decoded) && !decoder.failed() && in.empty());
+    assert(!text_decoder.next_text(text_in, text) && !text_decoder.failed());
+}
+
+void test_ilf_binary()
+{
+    cout << "test_ilf_binary()" << endl << endl;
+
+    // every event type, as translated
+    vector<ILF> ilfs;
+    for (int i : { 1, 2, 3, 5, 6, 7, 8, 10, 11, 12, 13, 15, 17, 22, 23, 255 }) {
+        string s = input_base_path + to_string(i) + ".xml";
+        char *mock_cli[] = { (char *) "./main", (char *) "-m", (char *) field_mappings.c_str(),
+                             (char *) "-f", (char *) allowed_fields.c_str(), (char *) "-e", (char *) event_names.c_str(),
+                             (char *) "-l", (char *) s.c_str() };
+        XML_TO_ILF translator(9, mock_cli);
+        ILF *ilf = translator.process_event(translator.get_root()->child("Events").first_child());
+        ilfs.push_back(*ilf);
+        delete ilf;
+    }
+
+    // values and times that can only be sent as they are, or only in part
+    ilfs.push_back(ILF("Edge", "host", "*", "t", {}));
+    ilfs.push_back(ILF("", "", "", "", { key_val("", "") }));
+    for (string time : { "1969-12-31T23:59:59.9999999Z", "2023-11-10T00:47:00Z", "2024-02-29T12:00:00.123456789Z",
+                         "2023-02-29T12:00:00Z", "2023-11-10T00:47:00.Z", "2023-11-10 00:47:00.123", "0000-01-01T00:00:00Z",
+                         "9999-12-31T23:59:59.9Z", "2023-11-10T24:00:00Z", "2023-1-10T00:47:00.1234567Z" })
+        ilfs.push_back(ILF("Time", "host", "*", time, { key_val("a", "1") }));
+    ilfs.push_back(ILF("Values", "host", "*", "t", {
+        key_val("int", "17180"), key_val("zero", "0"), key_val("negative", "-5"), key_val("leading", "007"),
+        key_val("minus_zero", "-0"), key_val("big", "123456789012345678901234567890"), key_val("hex", "0x1F"),
+        key_val("decimal", "1.5"), key_val("empty", ""), key_val("empty_string", "\"\""),
+        key_val("string", "\"C:\\\\Windows\\\\System32\""), key_val("quote", "\"\\\"q\\\"\""),
+        key_val("hash", "\"D8CD7DEE9C56A21591096E9500B52208\""), key_val("lower", "\"d8cd7dee\""),
+        key_val("mixed", "\"D8cd\""), key_val("odd", "\"ABC\""), key_val("digits", "\"2\""),
+        key_val("bad_escape", "\"a\\b\""), key_val("bare_quote", "\"a\"b\""), key_val("open", "\"a"),
+        key_val("escaped_end", "\"a\\\"") }));
+
+    ILF_ENCODER encoder;
+    string stream;
+    for (ILF &ilf : ilfs)
+        encoder.encode(ilf, stream);
+    assert(stream.compare(0, ILF_BINARY_MAGIC_LEN, ILF_BINARY_MAGIC) == 0);
+    assert_round_trip(stream, ilfs);
+
+    // strings are sent once, so the stream ends up smaller than the text
+    size_t text_size = 0;
+    for (ILF &ilf : ilfs)
+        text_size += ilf.text_size();
+    assert(stream.size() < text_size);
+    string again;
+    encoder.encode(ilfs[0], again);
+    assert(again.size() < ilfs[0].text_size() / 2);
+
+    // a view encodes to the text it renders
+    ILF_VIEW view;
+    view.event_type = "Type";
+    view.sender = "host";
+    view.receiver = "*";
+    view.time = "2023-11-10T00:47:00.9176581Z";
+    view.attributes = { { "a", "1", QUOTE_NEVER }, { "b", "x\"y", QUOTE_UNLESS_NUMBER }, { "c", "2", QUOTE_ALWAYS },
+                        { "d", "AB", QUOTE_ALWAYS }, { "e", "0x10", QUOTE_UNLESS_NUMBER } };
+    ILF_ENCODER view_encoder;
+    view_encoder.intern("Type");
+    string header, view_stream;
+    view_encoder.begin(header);
+    view.encode(view_encoder, view_stream);
+    vector<ILF> view_ilfs = { view.to_ilf() };
+    assert_round_trip(header + view_stream, view_ilfs);
+
+    // a stream decoded in pieces that end between frames
+    ILF_DECODER pieces;
+    string_view first = string_view(header), second = view_stream;
+    ILF decoded;
+    assert(!pieces.next(first, decoded) && !pieces.failed());
+    assert(pieces.next(second, decoded) && decoded.to_string() == view_ilfs[0].to_string());
+
+    // cut or damaged streams fail, without appending any text
+    for (size_t cut = 1; cut < stream.size(); cut += 7) {
+        ILF_DECODER decoder;
+        string_view in = string_view(stream).substr(0, cut);
+        string text;
+        while (decoder.next_text(in, text))
+            text.clear();
+        assert(decoder.failed() || in.empty());
+    }
+    ILF_DECODER wrong_magic;
+    string_view wrong = "ILFX\x01";
+    assert(!wrong_magic.next(wrong, decoded) && wrong_magic.failed());
+
+    cout << "* * * * " << endl;
+}
+
+// Checks that the text parses back to the ILF it was printed from
+static void assert_parses_to(ILF_PARSER &parser, ILF &ilf)
+{
+    string text = ilf.to_string();
+    assert(parser.parse(text));
+    assert(parser.to_ilf().to_string() == text);
+
+    vector<key_val> key_vals = ilf.get_key_vals();
+    assert(parser.pairs.size() == key_vals.size());
+    for (size_t i = 0; i < key_vals.size(); i++)
+        assert(parser.pairs[i].key == key_vals[i].key && parser.pairs[i].value == key_vals[i].value);
+}
+
+void test_ilf_parser()
+{
+    cout << "test_ilf_parser()" << endl << endl;
+
+    // the translator's output for every event of the input logs
+    vector<ILF> ilfs;
+    vector<string> files = { "five_events.xml" };
+    for (int i = 1; i <= 24; i++)
+        files.push_back(to_string(i) + ".xml");
+    files.push_back("255.xml");
+    for (string &file : files) {
+        string s = input_base_path + file;
+        if (!ifstream(s))
+            continue;
+        char *mock_cli[] = { (char *) "./main", (char *) "-m", (char *) field_mappings.c_str(),
+                             (char *) "-f", (char *) allowed_fields.c_str(), (char *) "-e", (char *) event_names.c_str(),
+                             (char *) "-l", (char *) s.c_str() };
+        XML_TO_ILF translator(9, mock_cli);
+        for (xml_node event : translator.get_root()->child("Events").children()) {
+            ILF *ilf = translator.process_event(event);
+            ilfs.push_back(*ilf);
+            delete ilf;
+        }
+    }
+    assert(ilfs.size() > 20);
+
+    // values holding the delimiters, escapes on both sides of the vector kernels' blocks, and
+    // values long enough for them
+    string long_value = "\"" + string(100, 'x') + "\"";
+    ilfs.push_back(ILF("Edge", "host", "*", "t", {}));
+    ilfs.push_back(ILF("", "", "", "", { key_val("", "") }));
+    ilfs.push_back(ILF("Edge", "host", "*", "t", {
+        key_val("delimiters", "\"a;b)c]d=e,f(g[\""), key_val("empty", ""), key_val("quotes", "\"\\\"q\\\"\""),
+        key_val("backslashes", "\"C:\\\\Windows\\\\\""), key_val("long", long_value), key_val("last", "1") }));
+    for (size_t at : { 0, 14, 15, 16, 30, 31, 32, 33, 63, 64, 99 }) {
+        string escaped = long_value;
+        escaped.insert(1 + at, "\\\"");
+        ilfs.push_back(ILF("Escape", "host", "*", "t", { key_val("value", escaped), key_val("next", "\"n\"") }));
+    }
+
+    ILF_PARSER parser;
+    ilf_parse_kernel best = get_ilf_parse_kernel();
+    for (ilf_parse_kernel kernel : { ILF_PARSE_SCALAR, ILF_PARSE_SSE2, ILF_PARSE_AVX2 }) {
+        if (!set_ilf_parse_kernel(kernel))
+            continue;
+        cout << "  kernel " << get_ilf_parse_kernel_name(kernel) << endl;
+
+        for (ILF &ilf : ilfs)
+            assert_parses_to(parser, ilf);
+
+        // the events one per line, as the translator writes them
+        string lines;
+        for (ILF &ilf : ilfs)
+            lines += ilf.to_string() + "\n";
+        string_view in = lines;
+        for (ILF &ilf : ilfs) {
+            assert(parser.next(in));
+            assert(parser.to_ilf().to_string() == ilf.to_string());
+        }
+        assert(!parser.next(in) && in.empty());
+    }
+    set_ilf_parse_kernel(best);
+
+    string unquoted;
+    ILF_PARSER::unquote("\"C:\\\\a \\\"b\\\"\"", unquoted);
+    assert(unquoted == "C:\\a \"b\"");
+    unquoted.clear();
+    ILF_PARSER::unquote("17180", unquoted);
+    assert(unquoted == "17180" && !ILF_PARSER::is_quoted("17180") && ILF_PARSER::is_quoted("\"\""));
+
+    // malformed events
+    for (string text : { "", "Type", "Type[host,*,t,()", "Type[host,*,t,(a=1]", "Type[host,*,t,(a)]",
+                         "Type[host,*,t,(a=\"1)]", "Type[host,*,t,(a=\"1\\\")]", "Type[host,*,t,(a=\"1\"2)]",
+                         "Type[host,*,(a=1)]", "Type[host,*,t,(a=1)] x", "Type[host,*,t,(a=1;)]" })
+        assert(!parser.parse(text));
+
+    // a malformed event stops the stream where it starts
+    string_view stream = "A[h,*,t,(a=1)] \nB[h,*,t,(b=\"2)] \n";
+    assert(parser.next(stream) && parser.event_type == "A");
+    assert(!parser.next(stream) && stream.substr(0, 2) == "B[");
+
+    cout << "* * * * " << endl;
+}
+
+// Runs the translator on the five events with the given outputs, and no Redis
+static void translate_to(const string &outputs)
+{
+    string logs = input_base_path + "five_events.xml";
+    char *mock_cli[] = { (char *) "./main",
+                            (char *) "-m",
+                            (char *) field_mappings.c_str(),
+                            (char *) "-f",
+                            (char *) allowed_fields.c_str(),
+                            (char *) "-e",
+                            (char *) event_names.c_str(),
+                            (char *) "-l",
+                            (char *) logs.c_str(),
+                            (char *) "-o",
+                            (char *) outputs.c_str() };
+
+    XML_TO_ILF translator = XML_TO_ILF(11, mock_cli);
+    assert(translator.run() == 0);
+    assert(translator.get_num_events_processed() == 5);
+}
+
+// Queued sink whose thread takes its first batches and then waits to be released before consuming
+// them, keeping the sequence numbers of the events it consumed
+class HELD_SINK : public QUEUED_SINK {
+    public:
+        vector<uint64_t> consumed;
+
+        HELD_SINK(const sink_spec &spec, METRICS &metrics): QUEUED_SINK(spec, false)
+        {
+            track_queue(metrics, "held");
+            start();
+        }
+
+        ~HELD_SINK()
+        {
+            release();
+            stop();
+        }
+
+        void release()
+        {
+            lock_guard<mutex> guard(hold);
+            released = true;
+            go.notify_all();
+        }
+
+    protected:
+        void consume(vector<event_batch> &batches) override
+        {
+            unique_lock<mutex> guard(hold);
+            go.wait(guard, [this]() { return released; });
+            for (event_batch &batch : batches) {
+                for (size_t i = 0; i < batch.ends.size(); i++)
+                    consumed.push_back(batch.first_sequence + i);
+            }
+        }
+
+    private:
+        mutex hold;
+        condition_variable go;
+        bool released = false;
+};
+
+// Writes events 1 to count, one per batch, to a HELD_SINK with room for two batches
+static void write_held(HELD_SINK &sink, int count)
+{
+    for (int i = 1; i <= count; i++) {
+        rendered_event event;
+        event.text = "e";
+        event.sequence = i;
+        sink.write(event);
+    }
+}
+
+void test_output_sinks()
+{
+    cout << "test_output_sinks()" << endl << endl;
+
+    sink_spec defaults;
+    defaults.format = SINK_BINARY;
+    defaults.batch_lines = 7;
+    vector<sink_spec> specs;
+    string error;
+    assert(parse_sink_specs("stdout,file:out.ilf?batch=4096&linger=100&format=text,unix:/tmp/s,redis", defaults, specs, error));
+    assert(specs.size() == 4);
+    assert(specs[0].kind == "stdout" && specs[0].target.empty() && specs[0].format == SINK_BINARY && specs[0].batch_lines == 7);
+    assert(specs[1].kind == "file" && specs[1].target == "out.ilf" && specs[1].format == SINK_TEXT);
+    assert(specs[1].batch_lines == 4096 && specs[1].linger_ms == 100);
+    assert(specs[2].kind == "unix" && specs[2].target == "/tmp/s" && specs[2].format == SINK_BINARY);
+    // Redis only publishes text, whatever the default
+    assert(specs[3].kind == "redis" && specs[3].format == SINK_TEXT);
+    assert(specs[3].full == SINK_FULL_BLOCK && specs[3].queue_batches == LINE_WRITER_MAX_BATCHES);
+
+    specs.clear();
+    assert(parse_sink_specs("redis?queue=64&full=spill&spill=/tmp/ilf.spill,redis?full=drop_oldest", defaults, specs, error));
+    assert(specs[0].queue_batches == 64 && specs[0].full == SINK_FULL_SPILL && specs[0].spill_path == "/tmp/ilf.spill");
+    assert(specs[1].full == SINK_FULL_DROP_OLDEST);
+
+    specs.clear();
+    assert(parse_sink_specs("redis_stream,redis_stream?maxlen=5000&queue=8", defaults, specs, error));
+    assert(specs[0].kind == "redis_stream" && specs[0].format == SINK_TEXT && specs[0].stream_max_length == 1000000);
+    assert(specs[1].stream_max_length == 5000 && specs[1].queue_batches == 8);
+
+    for (string list : { "", "kafka", "file", "stdout:x", "redis?format=binary", "file:x?batch=", "file:x?batch=-1",
+                         "file:x?size=1", "stdout?format=xml", "redis?full=spill", "redis?queue=0", "file:x?full=block",
+                         "redis?full=drop", "redis_stream:x", "redis_stream?format=binary", "redis?maxlen=10" }) {
+        specs.clear();
+        error.clear();
+        assert(!parse_sink_specs(list, defaults, specs, error) && !error.empty());
+    }
+
+    // the same events in a text file, a binary file and a socket, without Redis
+    string text_path = "sink_test.txt", binary_path = "sink_test.bin", socket_path = "sink_test.sock";
+    remove(text_path.c_str());
+    remove(binary_path.c_str());
+    translate_to("file:" + text_path + "?batch=2,file:" + binary_path + "?format=binary");
+    string text = read_output(text_path);
+    assert(count(text.begin(), text.end(), '\n') == 5);
+
+    ILF_DECODER decoder;
+    string binary = read_output(binary_path), decoded;
+    string_view in = binary;
+    while (decoder.next_text(in, decoded))
+        decoded += "\n";
+    assert(!decoder.failed() && in.empty() && decoded == text);
+
+    // files are appended to, binary ones with a stream of their own that decodes after the first
+    translate_to("file:" + text_path + ",file:" + binary_path + "?format=binary");
+    assert(read_output(text_path) == text + text);
+    ILF_DECODER appended_decoder;
+    binary = read_output(binary_path);
+    in = binary;
+    decoded.clear();
+    while (appended_decoder.next_text(in, decoded))
+        decoded += "\n";
+    assert(!appended_decoder.failed() && in.empty() && decoded == text + text);
+
+    // -q 1 takes standard out off a list given with -o too
+    {
+        string logs = input_base_path + "five_events.xml", outputs = "stdout,file:" + text_path;
+        char *mock_cli[] = { (char *) "./main", (char *) "-m", (char *) field_mappings.c_str(),
+                             (char *) "-f", (char *) allowed_fields.c_str(), (char *) "-e",
+                             (char *) event_names.c_str(), (char *) "-l", (char *) logs.c_str(),
+                             (char *) "-o", (char *) outputs.c_str(), (char *) "-q", (char *) "1" };
+        XML_TO_ILF translator = XML_TO_ILF(13, mock_cli);
+        assert(translator.run() == 0);
+        translator.flush_output();
+        assert(translator.get_metric("stdout_writes") == 0 && translator.get_metric("file_writes") > 0);
+    }
+    assert(read_output(text_path) == text + text + text);
+
+    remove(socket_path.c_str());
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socket_path.c_str());
+    assert(bind(listener, (struct sockaddr *) &address, sizeof(address)) == 0 && listen(listener, 1) == 0);
+
+    string received;
+    thread reader([&]() {
+        int connection = accept(listener, nullptr, nullptr);
+        char buffer[4096];
+        ssize_t n;
+        while ((n = read(connection, buffer, sizeof(buffer))) > 0)
+            received.append(buffer, n);
+        close(connection);
+    });
+    translate_to("unix:" + socket_path + "?batch=1&linger=0");
+    reader.join();
+    assert(received == text);
+
+    close(listener);
+    remove(socket_path.c_str());
+    remove(text_path.c_str());
+    remove(binary_path.c_str());
+
+    // what a queued sink does when its thread falls behind
+    sink_spec queued;
+    queued.kind = "redis";
+    queued.batch_lines = 1;
+    queued.linger_ms = 0;
+    queued.queue_batches = 2;
+    {
+        // the writer waits for room, and no event is lost
+        METRICS metrics;
+        HELD_SINK sink(queued, metrics);
+        thread releaser([&]() {
+            this_thread::sleep_for(chrono::milliseconds(50));
+            sink.release();
+        });
+        write_held(sink, 10);
+        sink.flush();
+        releaser.join();
+        assert(sink.consumed == vector<uint64_t>({ 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 }));
+        assert(metrics.get("held_blocked_us") > 0 && metrics.get("held_dropped") == 0);
+        assert(metrics.get("held_queued_events") == 0 && metrics.get("held_queued_events_max") >= 3);
+    }
+    {
+        // the newest events are kept
+        METRICS metrics;
+        queued.full = SINK_FULL_DROP_OLDEST;
+        HELD_SINK sink(queued, metrics);
+        write_held(sink, 10);
+        sink.release();
+        sink.flush();
+        assert(is_sorted(sink.consumed.begin(), sink.consumed.end()) && sink.consumed.back() == 10);
+        assert(metrics.get("held_dropped") == (long long) (10 - sink.consumed.size()) && metrics.get("held_dropped") > 0);
+        assert(metrics.get("held_blocked_us") == 0 && metrics.get("held_queued_events") == 0);
+    }
+    {
+        // every event is consumed, in order, and the spill file is removed once it has been read back
+        METRICS metrics;
+        queued.full = SINK_FULL_SPILL;
+        queued.spill_path = "sink_test.spill";
+        HELD_SINK sink(queued, metrics);
+        write_held(sink, 10);
+        assert(metrics.get("held_spilled") > 0 && metrics.get("held_queued_events") == 10);
+        assert(access(queued.spill_path.c_str(), F_OK) == 0);
+        sink.release();
+        sink.flush();
+        assert(sink.consumed == vector<uint64_t>({ 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 }));
+        assert(metrics.get("held_dropped") == 0 && metrics.get("held_queued_events") == 0);
+        assert(access(queued.spill_path.c_str(), F_OK) != 0);
+    }
+
+    cout << "* * * * " << endl;
+}
+
+// Names of the files in a directory, sorted; none if there is no directory
+static vector<string> list_directory(const string &path)
+{
+    vector<string> names;
+    DIR *entries = opendir(path.c_str());
+    if (entries == nullptr)
+        return names;
+    while (struct dirent *entry = readdir(entries)) {
+        if (entry->d_name[0] != '.')
+            names.push_back(entry->d_name);
+    }
+    closedir(entries);
+    sort(names.begin(), names.end());
+    return names;
+}
+
+static void remove_directory(const string &path)
+{
+    for (string name : list_directory(path))
+        remove((path + "/" + name).c_str());
+    rmdir(path.c_str());
+}
+
+void test_segment_sink()
+{
+    cout << "test_segment_sink()" << endl << endl;
+
+    sink_spec defaults;
+    vector<sink_spec> specs;
+    string error;
+    assert(parse_sink_specs("segments:archive?size=64M&age=3600&block=256K&direct=1&fsync=interval&fsync_ms=200",
+                            defaults, specs, error));
+    assert(specs[0].kind == "segments" && specs[0].target == "archive" && specs[0].segment_bytes == 64ull << 20);
+    assert(specs[0].segment_seconds == 3600 && specs[0].block_bytes == 256 << 10 && specs[0].direct_io);
+    assert(specs[0].fsync == SINK_FSYNC_INTERVAL && specs[0].fsync_interval_ms == 200);
+    for (string list : { "segments", "segments:a?size=0", "segments:a?size=1T", "segments:a?fsync=always", "stdout?size=1K" })
+        assert(!parse_sink_specs(list, defaults, specs, error));
+
+    assert(SEGMENT_SINK::segment_name(1, 25, SINK_TEXT) == "ilf-00000000000000000001-00000000000000000025.ilf");
+
+    // segments small enough to take one or two events each, next to the same events in one file
+    string directory = "segment_test", text_path = "segment_test.txt";
+    remove_directory(directory);
+    remove(text_path.c_str());
+    translate_to("segments:" + directory + "?size=2K&block=4K&fsync=batch,file:" + text_path);
+    string text = read_output(text_path);
+
+    vector<string> names = list_directory(directory);
+    assert(names.size() > 1);
+    string joined;
+    unsigned long long expected_first = 1;
+    for (string &name : names) {
+        unsigned long long first, last;
+        assert(sscanf(name.c_str(), "ilf-%20llu-%20llu.ilf", &first, &last) == 2);
+        assert(first == expected_first && last >= first && name == SEGMENT_SINK::segment_name(first, last, SINK_TEXT));
+        string segment = read_output(directory + "/" + name);
+        assert(segment.size() <= 2048 || first == last);
+        assert((unsigned long long) count(segment.begin(), segment.end(), '\n') == last - first + 1);
+        joined += segment;
+        expected_first = last + 1;
+    }
+    assert(expected_first == 6 && joined == text);
+
+    // a later run carries on from the last event already archived
+    translate_to("segments:" + directory);
+    names = list_directory(directory);
+    assert(names.back() == SEGMENT_SINK::segment_name(6, 10, SINK_TEXT));
+    assert(read_output(directory + "/" + names.back()) == text);
+
+    // a segment left open by a crash keeps its complete events, and the next run numbers after them
+    string crashed = directory + "/ilf-00000000000000000011.open";
+    ofstream left_open(crashed, ios::binary);
+    string complete = "Process[host,,1,(CommandLine=\"cmd /c echo a\nb\";Image=a.exe)]\n\n"
+                      "Network[host,,2,(Port=80)]\n\n";
+    left_open << complete << "File[host,,3,(Name=\"half\n of a thi" << string(100, '\0');
+    left_open.close();
+    translate_to("segments:" + directory);
+    names = list_directory(directory);
+    assert(names.size() >= 3 && names[names.size() - 2] == SEGMENT_SINK::segment_name(11, 12, SINK_TEXT));
+    assert(read_output(directory + "/" + names[names.size() - 2]) == complete);
+    assert(names.back() == SEGMENT_SINK::segment_name(13, 17, SINK_TEXT));
+    assert(read_output(directory + "/" + names.back()) == text);
+
+    // an event isn't complete until its terminator is written
+    ofstream unterminated(directory + "/ilf-00000000000000000018.open", ios::binary);
+    unterminated << "Network[host,,4,(Port=443)]\nNetwork[host,,5,(Port=53)]";
+    unterminated.close();
+    translate_to("segments:" + directory);
+    names = list_directory(directory);
+    assert(names[names.size() - 2] == SEGMENT_SINK::segment_name(18, 18, SINK_TEXT));
+    assert(read_output(directory + "/" + names[names.size() - 2]) == "Network[host,,4,(Port=443)]\n");
+    assert(names.back() == SEGMENT_SINK::segment_name(19, 23, SINK_TEXT));
+    remove_directory(directory);
+
+    // binary segments can each be decoded on their own
+    translate_to("segments:" + directory + "?format=binary&size=1K");
+    names = list_directory(directory);
+    assert(names.size() > 1);
+    string decoded;
+    for (string &name : names) {
+        string segment = read_output(directory + "/" + name);
+        assert(name.substr(name.size() - 5) == ".ilfb");
+        ILF_DECODER decoder;
+        string_view in = segment;
+        while (decoder.next_text(in, decoded))
+            decoded += "\n";
+        assert(!decoder.failed() && in.empty());
+    }
+    assert(decoded == text);
+
+    remove_directory(directory);
+    remove(text_path.c_str());
+
+    cout << "* * * * " << endl;
+}
+
+void test_ring_sink()
+{
+    cout << "test_ring_sink()" << endl << endl;
+
+    string name = "/ilf_test_ring", error;
+    ILF_RING_READER reader;
+    assert(!reader.open(name, error));
+
+    // records of every size come back in order, across the end of the data area
+    {
+        ILF_RING_WRITER writer;
+        assert(writer.create(name, 1000, error));
+        assert(reader.open(name, error));
+        string_view record;
+        assert(!reader.next(record, 0));
+        for (int i = 0; i < 2000; i++) {
+            string expected(i % 300, 'a' + i % 26);
+            assert(writer.try_write(expected, true));
+            assert(reader.next(record, 0) && record == expected);
+        }
+
+        // a full ring drops records, which the reader can see
+        int written = 0;
+        while (writer.try_write("0123456789", true))
+            written++;
+        assert(writer.get_capacity() == 4096 && ILF_RING_WRITER::record_bytes(10) == 16);
+        assert(written > 100 && written <= 4096 / 16 && writer.get_dropped() == 1 && reader.get_dropped() == 1);
+        assert(!writer.try_write(string(5000, 'x'), true) && writer.get_dropped() == 2);
+        for (int i = 0; i < written; i++)
+            assert(reader.next(record, 0) && record == "0123456789");
+        assert(!reader.next(record, 0) && !reader.closed());
+
+        // what was written before closing is still read
+        assert(writer.try_write("last", true));
+        writer.close();
+        assert(reader.next(record) && record == "last" && !reader.next(record) && reader.closed());
+    }
+
+    // a record that doesn't fit before the end of the data area waits for its own bytes at the
+    // start, not for the end too, which would be more than an empty ring has
+    {
+        ILF_RING_WRITER writer;
+        assert(writer.create(name, 8192, error) && reader.open(name, error));
+        string_view record;
+        string small(4000, 's'), large(5000, 'l');
+        assert(writer.try_write(small, true) && reader.next(record, 0) && record == small);
+        assert(!writer.try_write(large, true) && writer.get_dropped() == 1);
+        assert(!reader.next(record, 0));
+        assert(writer.try_write(large, true) && reader.next(record, 0) && record == large);
+        writer.close();
+    }
+
+    // a reader sleeping on the ring is woken for every record, in order
+    {
+        ILF_RING_WRITER writer;
+        assert(writer.create(name, 4096, error) && reader.open(name, error));
+        reader.set_spin_us(0);
+        int count = 0;
+        bool in_order = true;
+        thread consumer([&]() {
+            string_view record;
+            while (reader.next(record, 10000))
+                in_order = in_order && record == to_string(count++);
+        });
+        for (int i = 0; i < 100000; i++) {
+            while (!writer.try_write(to_string(i), false))
+                this_thread::yield();
+            if (i % 1000 == 0)
+                this_thread::sleep_for(chrono::microseconds(200));
+        }
+        writer.close();
+        consumer.join();
+        assert(count == 100000 && in_order);
+    }
+
+    // the translator's ring sink, read as the translator writes it
+    string text_path = "ring_test.txt";
+    remove(text_path.c_str());
+    string logs = input_base_path + "five_events.xml", outputs = "ring:ilf_test_ring?size=4K&full=block,file:" + text_path;
+    char *mock_cli[] = { (char *) "./main",
+                            (char *) "-m",
+                            (char *) field_mappings.c_str(),
+                            (char *) "-f",
+                            (char *) allowed_fields.c_str(),
+                            (char *) "-e",
+                            (char *) event_names.c_str(),
+                            (char *) "-l",
+                            (char *) logs.c_str(),
+                            (char *) "-o",
+                            (char *) outputs.c_str() };
+    string received;
+    XML_TO_ILF *translator = new XML_TO_ILF(11, mock_cli);
+    assert(reader.open(name, error));
+    thread consumer([&]() {
+        string_view record;
+        while (reader.next(record, 10000))
+            received += string(record) + "\n";
+    });
+    assert(translator->run() == 0);
+    assert(translator->get_metric("ring_written") == 5 && translator->get_metric("ring_dropped") == 0);
+    delete translator;
+    consumer.join();
+    assert(received == read_output(text_path));
+    remove(text_path.c_str());
+
+    sink_spec defaults;
+    vector<sink_spec> specs;
+    for (string list : { "ring", "ring:r?format=binary", "ring:r?full=wait", "ring:r?size=0" })
+        assert(!parse_sink_specs(list, defaults, specs, error));
+
+    // with full=block, events bigger than the size asked for are waited for as long as they fit
+    // in the ring, which is rounded up to a power of two
+    {
+        assert(parse_sink_specs("ring:ilf_test_ring?size=5000&full=block", defaults, specs, error));
+        metric written = 0, dropped = 0;
+        RING_SINK sink(specs[0], written, dropped);
+        assert(sink.open(error) && reader.open(name, error));
+        string fits(8188, 'f'), too_big(8189, 'b');
+        rendered_event event = { fits, "\n", "", 1 };
+        sink.write(event);
+        thread consumer([&]() {
+            string_view record;
+            for (int i = 0; i < 2; i++)
+                assert(reader.next(record, 10000) && record == fits);
+        });
+        sink.write(event);
+        consumer.join();
+        event.text = too_big;
+        sink.write(event);
+        assert(written == 2 && dropped == 1);
+        sink.stop();
+    }
+
+    // and wait for the reader to pass the end of the data area when they don't fit before it
+    {
+        assert(parse_sink_specs("ring:ilf_test_ring?size=8K&full=block", defaults, specs, error));
+        metric written = 0, dropped = 0;
+        RING_SINK sink(specs[0], written, dropped);
+        assert(sink.open(error) && reader.open(name, error));
+        string small(4000, 's'), large(5000, 'l');
+        string_view record;
+        rendered_event event = { small, "\n", "", 1 };
+        sink.write(event);
+        assert(reader.next(record, 0) && record == small);
+        thread consumer([&]() {
+            string_view record;
+            assert(reader.next(record, 10000) && record == large);
+        });
+        event.text = large;
+        sink.write(event);
+        consumer.join();
+        assert(written == 2 && dropped == 0);
+        sink.stop();
+    }
+
+    cout << "* * * * " << endl;
+}
+
+#ifdef GENERATED_TRANSLATORS
+// Translates a log file with the given translators and engine into a new file
+static string translate_file(const string &logs, const string &translators, const string &engine)
+{
+    string output_path = "generated_test.ilf", outputs = "file:" + output_path;
+    remove(output_path.c_str());
+    char *mock_cli[] = { (char *) "./main",
+                            (char *) "-m",
+                            (char *) field_mappings.c_str(),
+                            (char *) "-f",
+                            (char *) allowed_fields.c_str(),
+                            (char *) "-e",
+                            (char *) event_names.c_str(),
+                            (char *) "-l",
+                            (char *) logs.c_str(),
+                            (char *) "-r",
+                            (char *) "mmap",
+                            (char *) "-p",
+                            (char *) engine.c_str(),
+                            (char *) "-c",
+                            (char *) translators.c_str(),
+                            (char *) "-o",
+                            (char *) outputs.c_str() };
+    {
+        XML_TO_ILF translator = XML_TO_ILF(17, mock_cli);
+        assert(translator.run() == 0);
+    }
+    string ilf = read_output(output_path);
+    remove(output_path.c_str());
+    return ilf;
+}
+#endif
+
+// The translators generated from the configuration files write the same ILF text, byte for byte,
+// as the plans compiled from them, for every log file and with both engines
+void test_generated_translators()
+{
+#ifdef GENERATED_TRANSLATORS
+    cout << "test_generated_translators()" << endl << endl;
+
+    size_t compared = 0;
+    for (string &name : list_directory(input_base_path)) {
+        if (name.size() < 4 || name.substr(name.size() - 4) != ".xml")
+            continue;
+        for (string engine : { "pugixml", "scanner" }) {
+            string json_ilf = translate_file(input_base_path + name, "json", engine);
+            assert(translate_file(input_base_path + name, "generated", engine) == json_ilf);
+            compared += !json_ilf.empty();
+        }
+    }
+    assert(compared > 0);
+
+    cout << "* * * * " << endl;
+#endif
+}